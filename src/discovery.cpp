@@ -0,0 +1,198 @@
+#include "discovery.h"
+
+#include <ESP8266mDNS.h>
+#include <LittleFS.h>
+
+#include "logger.h"
+#include "rpc.h"
+#include "wifi_link.h"
+
+// ===== Saved host =====
+const uint32_t KODI_CACHE_MAGIC = 0x4B484331;   // "KHC1"
+const char*    KODI_CACHE_PATH  = "/kodi.bin";
+
+struct KodiCache {
+  uint32_t magic;
+  uint32_t ip;
+  uint16_t port;
+  uint16_t reserved;
+};
+
+static uint8_t     gTarget = 0;
+static KodiHost    gHosts[DISCOVERY_HOSTS_MAX];
+static uint8_t     gNumHosts = 0;
+static int8_t      gCurrent  = -1;
+static uint8_t     gFailAfter = 3;
+static uint16_t    gFailovers = 0;
+static const char* gHostname = nullptr;
+static const char* gService  = nullptr;
+static bool        gStarted  = false;
+static KodiCache   gSaved;
+static DiscoveryGateFn gSaveGate = nullptr;
+
+static MDNSResponder::hMDNSServiceQuery gQuery = nullptr;
+
+// ===== Candidates =====
+static int8_t findHost(const IPAddress& ip, uint16_t port) {
+  for (uint8_t i = 0; i < gNumHosts; i++) {
+    if (gHosts[i].ip == ip && gHosts[i].port == port) return i;
+  }
+  return -1;
+}
+
+static int8_t addHost(const IPAddress& ip, uint16_t port, const char* name) {
+  int8_t i = findHost(ip, port);
+  if (i < 0) {
+    if (gNumHosts >= DISCOVERY_HOSTS_MAX) return -1;
+    i = gNumHosts++;
+    KodiHost& h = gHosts[i];
+    h.ip      = ip;
+    h.port    = port;
+    h.seenMs  = 0;
+    h.name[0] = '\0';
+    LOG_I("Kodi candidate %s %u.%u.%u.%u:%u", name, ip[0], ip[1], ip[2], ip[3], port);
+  }
+  if (name && *name) strlcpy(gHosts[i].name, name, sizeof(gHosts[i].name));
+  return i;
+}
+
+static void saveHost(const IPAddress& ip, uint16_t port) {
+  KodiCache c = { KODI_CACHE_MAGIC, (uint32_t)ip, port, 0 };
+  if (memcmp(&c, &gSaved, sizeof(c)) == 0) return;
+  gSaved = c;
+  File f = LittleFS.open(KODI_CACHE_PATH, "w");
+  if (!f) return;
+  f.write((const uint8_t*)&c, sizeof(c));
+  f.close();
+}
+
+// Another rpc target already talks to this box
+static bool takenElsewhere(const KodiHost& h) {
+  for (uint8_t t = 0; t < rpcTargets(); t++) {
+    if (t == gTarget) continue;
+    RpcScope at(t);
+    if (rpcHost() == h.ip && rpcPort() == h.port) return true;
+  }
+  return false;
+}
+
+static void forgetSaved() {
+  memset(&gSaved, 0, sizeof(gSaved));
+  LittleFS.remove(KODI_CACHE_PATH);
+}
+
+static void choose(int8_t i) {
+  gCurrent = i;
+  const KodiHost& h = gHosts[i];
+  LOG_I("Kodi host %s %u.%u.%u.%u:%u", h.name, h.ip[0], h.ip[1], h.ip[2], h.ip[3], h.port);
+  RpcScope at(gTarget);
+  rpcSetHost(h.ip, h.port);
+}
+
+// ===== mDNS =====
+static void onAnswer(MDNSResponder::MDNSServiceInfo info, MDNSResponder::AnswerType, bool set) {
+  if (!set || !info.IP4AddressAvailable() || !info.hostPortAvailable()) return;
+  uint16_t port = info.hostPort();
+  const char* name = info.hostDomainAvailable() ? info.hostDomain() : "";
+  for (const IPAddress& ip : info.IP4Adresses()) {
+    int8_t i = addHost(ip, port, name);
+    if (i >= 0) gHosts[i].seenMs = millis();
+  }
+}
+
+static void startMdns() {
+  gStarted = true;
+  if (!gService) return;
+  if (!MDNS.begin(gHostname)) { LOG_W("mDNS failed to start"); return; }
+  gQuery = MDNS.installServiceQuery(gService, "tcp", onAnswer);
+}
+
+// ===== Public =====
+void discoveryBegin(uint8_t target, const char* hostname, const char* service, const char* host,
+                    uint16_t port, uint8_t failAfter) {
+  gTarget    = target;
+  gHostname  = hostname;
+  gService   = service;
+  gFailAfter = failAfter;
+
+  // the configured host comes first and is tried first; the saved one is
+  // the last that worked, for when there is none or it stops answering
+  IPAddress ip;
+  if (host && *host && ip.fromString(host)) addHost(ip, port, "configured");
+
+  File f = LittleFS.open(KODI_CACHE_PATH, "r");
+  if (f) {
+    if (f.read((uint8_t*)&gSaved, sizeof(gSaved)) != sizeof(gSaved) || gSaved.magic != KODI_CACHE_MAGIC)
+      memset(&gSaved, 0, sizeof(gSaved));
+    f.close();
+  }
+  if (gSaved.magic == KODI_CACHE_MAGIC) addHost(IPAddress(gSaved.ip), gSaved.port, "saved");
+
+  if (gNumHosts > 0) choose(0);
+}
+
+void discoverySetHost(const char* host, uint16_t port) {
+  IPAddress ip;
+  bool set = host && *host && ip.fromString(host);
+
+  // the old configured and saved hosts go, mDNS answers stay
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < gNumHosts; i++) {
+    if (gHosts[i].seenMs && !(set && gHosts[i].ip == ip && gHosts[i].port == port)) gHosts[n++] = gHosts[i];
+  }
+  gNumHosts = n;
+  gCurrent  = -1;
+  forgetSaved();
+  if (!set) return;   // discoveryPoll() picks a discovered one
+
+  if (gNumHosts == DISCOVERY_HOSTS_MAX) gNumHosts--;
+  memmove(&gHosts[1], &gHosts[0], gNumHosts * sizeof(KodiHost));
+  gNumHosts++;
+  KodiHost& h = gHosts[0];
+  h.ip     = ip;
+  h.port   = port;
+  h.seenMs = 0;
+  strlcpy(h.name, "configured", sizeof(h.name));
+  choose(0);
+}
+
+void discoverySetSaveGate(DiscoveryGateFn fn) {
+  gSaveGate = fn;
+}
+
+void discoveryPoll() {
+  if (!wifiLinkUp()) return;
+  if (!gStarted) startMdns();
+  if (gQuery) MDNS.update();
+
+  if (gCurrent < 0) {
+    for (uint8_t i = 0; i < gNumHosts; i++) {
+      if (!takenElsewhere(gHosts[i])) { choose(i); break; }
+    }
+    return;
+  }
+  RpcScope at(gTarget);
+  // remembered once it has accepted a connection, as rpc has it; the
+  // flash write waits until the gate allows it
+  if (rpcConnected() && rpcFailStreak() == 0 && (!gSaveGate || gSaveGate()))
+    saveHost(rpcHost(), rpcPort());
+  if (gNumHosts < 2 || rpcFailStreak() < gFailAfter) return;
+
+  int8_t next = (gCurrent + 1) % gNumHosts;
+  while (next != gCurrent && takenElsewhere(gHosts[next])) next = (next + 1) % gNumHosts;
+  if (next == gCurrent) return;
+  LOG_W("Kodi host not answering, failing over");
+  gFailovers++;
+  choose(next);
+}
+
+void discoveryPrint(Print& out) {
+  out.printf("=== Kodi hosts (%u failovers) ===\n", gFailovers);
+  for (uint8_t i = 0; i < gNumHosts; i++) {
+    const KodiHost& h = gHosts[i];
+    out.printf("%c %u.%u.%u.%u:%u %s", i == gCurrent ? '*' : ' ', h.ip[0], h.ip[1], h.ip[2], h.ip[3],
+               h.port, h.name);
+    if (h.seenMs) out.printf(" (mDNS %lus ago)", (millis() - h.seenMs) / 1000);
+    out.printf("\n");
+  }
+}
@@ -0,0 +1,51 @@
+/*
+  Kodi discovery and failover
+
+  Kodi announces its JSON-RPC interfaces over mDNS: _xbmc-jsonrpc._tcp
+  (raw TCP) and _xbmc-jsonrpc-h._tcp (HTTP). Once WiFi is up a continuous
+  mDNS service query runs in the background, and every box that answers
+  becomes a candidate next to the configured host, if any. The address
+  that last accepted a connection is saved to /kodi.bin, so after a reboot
+  without a configured host the socket opens on it right away, before
+  any mDNS answer comes in. A configured host is always tried first.
+
+  Switching happens only in discoveryPoll(): when no host is chosen yet,
+  or when the current one has had failAfter connect failures or timeouts
+  in a row (rpcFailStreak()). Presses always go straight to the current
+  socket.
+
+  Discovery drives one rpc target. Boxes that another target already
+  talks to are never failed over to.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+const uint8_t DISCOVERY_HOSTS_MAX = 4;
+const uint8_t DISCOVERY_NAME_LEN  = 24;   // including the terminator
+
+struct KodiHost {
+  IPAddress     ip;
+  uint16_t      port;
+  char          name[DISCOVERY_NAME_LEN];
+  unsigned long seenMs;       // last mDNS answer, 0: configured or saved
+};
+
+// target: the rpc target to drive. service: mDNS service name without the
+// leading underscore, e.g. "xbmc-jsonrpc", nullptr disables mDNS. host may
+// be "" to rely on discovery only.
+void discoveryBegin(uint8_t target, const char* hostname, const char* service, const char* host,
+                    uint16_t port, uint8_t failAfter);
+void discoveryPoll();
+
+// Saving the host writes to flash, which stalls the loop; it only
+// happens while fn returns true, e.g. between presses. nullptr: always.
+typedef bool (*DiscoveryGateFn)();
+void discoverySetSaveGate(DiscoveryGateFn fn);
+
+// A new configured host, "" for none: it replaces the old one, is used
+// right away and the saved host is forgotten
+void discoverySetHost(const char* host, uint16_t port);
+
+void discoveryPrint(Print& out);
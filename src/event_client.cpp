@@ -0,0 +1,166 @@
+#include "event_client.h"
+
+#include <WiFiUdp.h>
+
+#include "latency.h"
+#include "rpc.h"
+#include "timer_wheel.h"
+
+// ===== Protocol =====
+// Every packet: "XBMC", version 2.0, then big endian type, sequence
+// number, packets in this message, payload length, client id and 10
+// reserved bytes
+const size_t   ES_HEADER_LEN   = 32;
+const uint16_t ES_PT_HELO      = 0x01;
+const uint16_t ES_PT_BUTTON    = 0x03;
+const uint16_t ES_BT_USE_NAME  = 0x01;
+const uint16_t ES_BT_DOWN      = 0x02;
+const uint16_t ES_BT_UP        = 0x04;
+const uint16_t ES_BT_QUEUE     = 0x10;
+const uint16_t ES_BT_NO_REPEAT = 0x20;
+const char*    ES_MAP          = "R1";   // remote button names
+
+// ===== Limits =====
+const size_t   EVENT_PAYLOAD_MAX  = 64;
+const uint32_t EVENT_IDLE_MS      = 50000;   // Kodi forgets clients after 60 s
+const uint32_t EVENT_UP_RESEND_MS = 40;
+
+struct EventTarget {
+  unsigned long lastMs;      // last datagram, 0: never
+  const char*   held;        // button Kodi is repeating, nullptr if none
+  const char*   released;    // its "up" still goes out once more
+  Timer         resend;
+};
+
+static WiFiUDP     gUdp;
+static uint16_t    gPort = 9777;
+static const char* gName = "";
+static uint32_t    gUid  = 0;
+static uint32_t    gSeq  = 0;
+static uint8_t     gPkt[ES_HEADER_LEN + EVENT_PAYLOAD_MAX];
+static EventTarget gTargets[RPC_TARGETS_MAX];
+
+// ===== Stats =====
+static uint32_t gSent   = 0;
+static uint32_t gHelos  = 0;
+static uint32_t gFailed = 0;
+
+const size_t kEventRamBytes = sizeof(gPkt) + sizeof(gTargets);
+
+// ===== Packets =====
+static uint8_t* put16(uint8_t* p, uint16_t v) {
+  *p++ = v >> 8;
+  *p++ = v;
+  return p;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t v) {
+  return put16(put16(p, v >> 16), v);
+}
+
+static uint8_t* putStr(uint8_t* p, const char* s) {
+  size_t n = strlen(s) + 1;
+  memcpy(p, s, n);
+  return p + n;
+}
+
+// Sends the payload written after the header to the selected target
+static bool sendPacket(EventTarget& t, uint16_t type, uint8_t* end) {
+  size_t len = end - gPkt;
+  uint8_t* p = gPkt;
+  memcpy(p, "XBMC", 4);
+  p += 4;
+  *p++ = 2;
+  *p++ = 0;
+  p = put16(p, type);
+  p = put32(p, ++gSeq);
+  p = put32(p, 1);
+  p = put16(p, len - ES_HEADER_LEN);
+  p = put32(p, gUid);
+  memset(p, 0, 10);
+
+  IPAddress ip = rpcHost();
+  bool ok = ip.isSet() && gUdp.beginPacket(ip, gPort) && gUdp.write(gPkt, len) == len && gUdp.endPacket();
+  if (!ok) { gFailed++; return false; }
+  gSent++;
+  t.lastMs = millis();
+  return true;
+}
+
+static bool hello(EventTarget& t) {
+  if (t.lastMs && millis() - t.lastMs < EVENT_IDLE_MS) return true;
+  uint8_t* p = putStr(gPkt + ES_HEADER_LEN, gName);
+  *p++ = 0;                      // no icon
+  p = put16(p, 0);               // reserved port
+  p = put32(p, 0);
+  p = put32(p, 0);
+  gHelos++;
+  return sendPacket(t, ES_PT_HELO, p);
+}
+
+static bool sendButton(EventTarget& t, const char* button, uint16_t flags) {
+  if (strlen(button) + strlen(ES_MAP) + 8 > EVENT_PAYLOAD_MAX || !hello(t)) return false;
+  uint8_t* p = gPkt + ES_HEADER_LEN;
+  p = put16(p, 0);               // code: by name
+  p = put16(p, flags | ES_BT_USE_NAME);
+  p = put16(p, 0);               // amount
+  p = putStr(p, ES_MAP);
+  p = putStr(p, button);
+  return sendPacket(t, ES_PT_BUTTON, p);
+}
+
+// A datagram is written the moment it is queued and nothing answers it
+static bool traced(EventTarget& t, const char* button, uint16_t flags) {
+  LatToken trace = latencyActive();
+  latencyQueued(trace);
+  bool ok = sendButton(t, button, flags);
+  latencyWritten(trace);
+  latencyReplied(trace, ok);
+  return ok;
+}
+
+static void onResend(uint32_t arg) {
+  EventTarget& t = gTargets[arg];
+  if (!t.released) return;
+  RpcScope at(arg);
+  sendButton(t, t.released, ES_BT_UP);
+  t.released = nullptr;
+}
+
+// ===== Public =====
+void eventBegin(uint16_t port, const char* deviceName) {
+  gPort = port;
+  gName = deviceName;
+  gUid  = ESP.getChipId();
+  for (uint8_t i = 0; i < RPC_TARGETS_MAX; i++) timerInit(gTargets[i].resend, onResend, i);
+}
+
+bool eventPress(const char* button) {
+  return traced(gTargets[rpcSelected()], button, ES_BT_DOWN | ES_BT_QUEUE | ES_BT_NO_REPEAT);
+}
+
+bool eventHold(const char* button) {
+  EventTarget& t = gTargets[rpcSelected()];
+  if (t.held == button) return true;
+  if (!traced(t, button, ES_BT_DOWN)) return false;
+  t.held = button;
+  return true;
+}
+
+void eventRelease() {
+  for (uint8_t i = 0; i < RPC_TARGETS_MAX; i++) {
+    EventTarget& t = gTargets[i];
+    if (!t.held) continue;
+    RpcScope at(i);
+    sendButton(t, t.held, ES_BT_UP);
+    t.released = t.held;
+    t.held     = nullptr;
+    timerArm(t.resend, EVENT_UP_RESEND_MS);
+  }
+}
+
+void eventPrint(Print& out) {
+  out.printf("=== EventServer ===\n");
+  out.printf("sent %lu datagrams (%lu HELO), %lu failed\n", (unsigned long)gSent,
+             (unsigned long)gHelos, (unsigned long)gFailed);
+}
@@ -0,0 +1,43 @@
+/*
+  Kodi EventServer client
+
+  Kodi's EventServer (UDP port 9777) takes remote buttons by name: no
+  connection to open, no JSON, one datagram per press. A held button goes
+  out once as "down" and Kodi repeats it at its own rate (Settings >
+  Services > Control, initial and continuous delay) until the "up"
+  datagram, so a hold costs two packets instead of a request per repeat.
+  Buttons are looked up in the remote ("R1") section of Kodi's keymap,
+  which also decides what they do in each window.
+
+  Datagrams go to the host of the selected rpc target, so failover and
+  several targets behave as for JSON-RPC. Nothing comes back: context,
+  state and replies still need the JSON-RPC connection, and a send only
+  fails when there is no host or the packet can't be handed to the stack.
+
+  Kodi drops clients that stay quiet for a minute, so a HELO goes out
+  right before the first button and again after EVENT_IDLE_MS of silence.
+  The "up" of a hold is sent twice in case one datagram is lost, since
+  Kodi would keep repeating otherwise.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+// deviceName shows up in Kodi's log; it must stay valid
+void eventBegin(uint16_t port, const char* deviceName);
+
+// One press of button on the selected target, not repeated by Kodi
+bool eventPress(const char* button);
+
+// Holds button down on the selected target; Kodi repeats it until
+// eventRelease(). Returns true without sending if it is already held.
+bool eventHold(const char* button);
+
+// Lets go of the button held on every target
+void eventRelease();
+
+void eventPrint(Print& out);
+
+// Packet buffer and per-target state
+extern const size_t kEventRamBytes;
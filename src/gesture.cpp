@@ -0,0 +1,215 @@
+#include "gesture.h"
+
+#include "logger.h"
+#include "nec_decoder.h"
+#include "timer_wheel.h"
+
+// ===== Repeat period =====
+const uint32_t REPEAT_PERIOD_MIN_US = 80000;
+const uint32_t REPEAT_PERIOD_MAX_US = 160000;
+
+static GestureTiming    gTiming;
+static GestureActionFn  gAction = nullptr;
+static GestureReleaseFn gOnRelease = nullptr;
+
+// ===== Held key =====
+static uint8_t       gHeld         = KEY_NONE;
+static unsigned long gPressStartUs = 0;   // frame start of the press
+static unsigned long gHoldStartUs  = 0;
+static unsigned long gLastSeenUs   = 0;   // frame start of its last frame or repeat
+static unsigned long gLastRepeatUs = 0;   // last hold repeat action
+static uint32_t      gRepeatPeriodUs = NEC_REPEAT_PERIOD_US;
+static bool          gHoldActive   = false;
+static bool          gChorded      = false;  // press used up by a chord
+static LatToken      gHeldTrace    = 0;
+static Timer         gReleaseTimer;
+
+// ===== Multi-tap =====
+static uint8_t  gPending      = KEY_NONE;  // button whose taps are held back
+static uint8_t  gTaps         = 0;
+static bool     gPendingTap   = false;     // let go inside the window, its tap waits too
+static LatToken gPendingTrace = 0;
+static Timer    gTapTimer;
+
+static uint16_t holdMs(uint8_t b) {
+  uint16_t ms = keymapButton(b).holdMs;
+  return ms ? ms : gTiming.holdMs;
+}
+
+static uint16_t multiMs(uint8_t b) {
+  uint16_t ms = keymapButton(b).multiMs;
+  return ms ? ms : gTiming.multiMs;
+}
+
+// Returns true if a rule matched and its action went out
+static bool run(uint8_t b, KeyTrigger t, LatToken trace, uint8_t partner = KEY_NONE,
+                uint8_t steps = 1) {
+  const KeyRule* r = keymapMatch(b, t, partner);
+  if (!r) return false;
+  latencySetActive(trace);
+  bool sent = gAction(*r, steps);
+  latencySetActive(0);
+  return sent;
+}
+
+// ===== Multi-tap =====
+static void flushTaps(uint8_t b, uint8_t taps, LatToken trace) {
+  if (taps >= 3 && run(b, KEY_TRIPLE, trace))      taps -= 3;
+  else if (taps >= 2 && run(b, KEY_DOUBLE, trace)) taps -= 2;
+  while (taps--) run(b, KEY_PRESS, trace);
+}
+
+static void flushPending() {
+  if (gPending == KEY_NONE) return;
+  uint8_t b = gPending;
+  bool tap = gPendingTap;
+  gPending    = KEY_NONE;
+  gPendingTap = false;
+  timerCancel(gTapTimer);
+  flushTaps(b, gTaps, gPendingTrace);
+  if (tap) run(b, KEY_TAP, gPendingTrace);
+}
+
+static void onTapTimer(uint32_t) {
+  flushPending();
+}
+
+static bool wantsMultiTap(uint8_t b) {
+  return keymapMatch(b, KEY_DOUBLE) || keymapMatch(b, KEY_TRIPLE) || keymapChordLead(b);
+}
+
+static void onPress(uint8_t b, LatToken trace) {
+  if (gPending != KEY_NONE && gPending != b) {
+    uint8_t lead = gPending;
+    bool single = gTaps == 1;
+    if (single && run(b, KEY_CHORD, trace, lead)) {
+      // both buttons are used up: nothing else fires for either
+      gPending    = KEY_NONE;
+      gPendingTap = false;
+      timerCancel(gTapTimer);
+      gChorded = true;
+      return;
+    }
+    flushPending();
+  }
+
+  if (gPending == b) {
+    gTaps++;
+    gPendingTrace = trace;
+    // a triple is still possible, keep waiting
+    if (gTaps == 2 && keymapMatch(b, KEY_TRIPLE)) { timerArm(gTapTimer, multiMs(b)); return; }
+    flushPending();
+    return;
+  }
+
+  if (!wantsMultiTap(b)) { run(b, KEY_PRESS, trace); return; }
+
+  gPending      = b;
+  gTaps         = 1;
+  gPendingTrace = trace;
+  timerArm(gTapTimer, multiMs(b));
+}
+
+// ===== Hold / release =====
+static void armRelease() {
+  uint32_t windowUs  = gRepeatPeriodUs * gTiming.releasePct / 100;
+  uint32_t elapsedUs = micros() - gLastSeenUs;
+  timerArm(gReleaseTimer, elapsedUs < windowUs ? (windowUs - elapsedUs) / 1000 : 0);
+}
+
+static void release() {
+  timerCancel(gReleaseTimer);
+  if (gHoldActive) LOG_D("%s RELEASE", keymapButtonName(gHeld));
+  // a chord lead's tap waits with its press, a chord may still take both
+  else if (gPending == gHeld && keymapChordLead(gHeld)) gPendingTap = true;
+  else if (!gChorded) run(gHeld, KEY_TAP, gHeldTrace);
+  if (gOnRelease) gOnRelease(gHeld);
+
+  gHeld       = KEY_NONE;
+  gHeldTrace  = 0;
+  gHoldActive = false;
+  gChorded    = false;
+}
+
+static void onReleaseTimer(uint32_t) {
+  // the repeat that should have followed the last one didn't come
+  if (gHeld != KEY_NONE) release();
+}
+
+static uint8_t repeatSteps(unsigned long nowUs) {
+  if (!gTiming.accelMs) return 1;
+  uint32_t doublings = (nowUs - gHoldStartUs) / (gTiming.accelMs * 1000UL);
+  uint8_t steps = 1;
+  while (doublings-- && steps * 2 <= gTiming.maxSteps) steps *= 2;
+  return steps;
+}
+
+static void holdStart() {
+  gHoldActive = true;
+  LOG_D("%s HOLD start", keymapButtonName(gHeld));
+  // a held back press still belongs before the hold
+  if (gPending == gHeld) flushPending();
+  run(gHeld, KEY_HOLD, gHeldTrace);
+}
+
+// ===== Public =====
+void gestureBegin(const GestureTiming& timing, GestureActionFn fn) {
+  gTiming = timing;
+  gAction = fn;
+  timerInit(gReleaseTimer, onReleaseTimer);
+  timerInit(gTapTimer, onTapTimer);
+}
+
+void gestureSetTiming(const GestureTiming& timing) {
+  gTiming = timing;
+}
+
+bool gestureIdle() {
+  return gHeld == KEY_NONE && gPending == KEY_NONE;
+}
+
+void gestureSetReleaseHandler(GestureReleaseFn fn) {
+  gOnRelease = fn;
+}
+
+void gestureFrame(uint8_t button, unsigned long frameStartUs, LatToken trace) {
+  // a full frame means the previous key, if any, was let go
+  if (gHeld != KEY_NONE) release();
+  if (button == KEY_NONE) { flushPending(); return; }
+
+  gHeld         = button;
+  gHeldTrace    = trace;
+  gPressStartUs = frameStartUs;
+  gLastSeenUs   = frameStartUs;
+  armRelease();
+  onPress(button, trace);
+}
+
+void gestureRepeat(unsigned long frameStartUs) {
+  // its frame was missed, or it was already released: nothing to tie it to
+  if (gHeld == KEY_NONE) return;
+
+  uint32_t period = frameStartUs - gLastSeenUs;
+  if (period >= REPEAT_PERIOD_MIN_US && period <= REPEAT_PERIOD_MAX_US)
+    gRepeatPeriodUs = (gRepeatPeriodUs * 3 + period) / 4;
+  gLastSeenUs = frameStartUs;
+  armRelease();
+  if (gChorded) return;
+
+  // repeats arrive on a fixed grid, act on the one closest to each deadline
+  uint32_t slack = gRepeatPeriodUs / 2;
+  if (!gHoldActive) {
+    if (frameStartUs - gPressStartUs + slack < holdMs(gHeld) * 1000UL) return;
+    gHoldStartUs  = frameStartUs;
+    gLastRepeatUs = frameStartUs;
+    holdStart();
+    return;
+  }
+  if (frameStartUs - gLastRepeatUs + slack >= gTiming.repeatMs * 1000UL &&
+      run(gHeld, KEY_REPEAT, 0, KEY_NONE, repeatSteps(frameStartUs)))
+    gLastRepeatUs = frameStartUs;
+}
+
+uint8_t gestureHeld() {
+  return gHeld;
+}
@@ -0,0 +1,61 @@
+/*
+  Gesture engine
+
+  Turns decoded frames and repeat bursts into keymap triggers:
+  - press fires right away, unless a double/triple rule currently matches
+    the button or a chord starts with it. Only then is it held back for
+    the button's multi-tap window, and a later press of the same button
+    becomes a double or triple; another button inside the window can
+    complete a chord
+  - hold starts on the repeat burst closest to the button's hold delay
+    and repeats on the repeat grid at the configured rate. The number of
+    steps per repeat doubles every accelMs of holding, up to maxSteps
+  - the key counts as released once the repeat that should follow the
+    last one is missing; tap fires then if no hold started. A chord
+    lead's tap waits for the window with its press, and a chord uses up
+    both buttons: neither's press, tap or hold fires
+
+  All deadlines run on the timer wheel, nothing here polls the clock.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "keymap.h"
+#include "latency.h"
+
+struct GestureTiming {
+  uint16_t holdMs;       // default hold delay
+  uint16_t multiMs;      // default multi-tap and chord window
+  uint16_t repeatMs;     // hold repeat rate
+  uint16_t releasePct;   // release window, in % of the measured repeat period
+  uint16_t accelMs;      // hold time per doubling of repeat steps, 0: off
+  uint8_t  maxSteps;
+};
+
+// Runs the action of a matched rule, steps times (only repeats use more
+// than one). Returns false if it wasn't sent.
+typedef bool (*GestureActionFn)(const KeyRule& rule, uint8_t steps);
+
+void    gestureBegin(const GestureTiming& timing, GestureActionFn fn);
+
+// Called once the held button is let go, after its tap if any (a chord
+// lead's tap comes when its window closes)
+typedef void (*GestureReleaseFn)(uint8_t button);
+void    gestureSetReleaseHandler(GestureReleaseFn fn);
+
+// New timings, between presses only (see gestureIdle())
+void    gestureSetTiming(const GestureTiming& timing);
+
+// No button held and no press held back for its multi-tap window
+bool    gestureIdle();
+
+// A full frame. button is KEY_NONE for keys the keymap doesn't know.
+void    gestureFrame(uint8_t button, unsigned long frameStartUs, LatToken trace);
+
+// A repeat burst
+void    gestureRepeat(unsigned long frameStartUs);
+
+// Button currently held, KEY_NONE if none
+uint8_t gestureHeld();
@@ -0,0 +1,134 @@
+#include "ir_capture.h"
+
+#include "sched.h"
+
+// ===== ISR state =====
+// Times are in backend ticks: microseconds or CPU cycles
+static IrRing<IR_RING_SIZE> sIrRing;
+static volatile uint32_t    sLastEdge   = 0;
+static volatile bool        sIdle       = true;   // set by loop, cleared by the ISR
+static uint32_t             sMinTicks   = 0;
+static uint32_t             sMaxTicks   = 0;
+static uint8_t              sPin        = 0;
+static volatile bool        sWakeArmed  = false;
+static volatile bool        sWoke       = false;   // set by the ISR, cleared by loop
+
+static IrCaptureBackend gBackend    = IR_CAPTURE_MICROS;
+static uint32_t         gFrameStart = 0;   // stamp of the frame whose marker was popped last
+
+const uint32_t CYCLES_PER_US = F_CPU / 1000000L;
+
+// Interrupt on every edge, or on a low line with light sleep wake enabled
+static IR_INLINE void setTrigger(uint8_t type, bool wake) {
+  GPC(sPin) = (GPC(sPin) & ~((0xF << GPCI) | (1 << GPCWE))) | (type << GPCI) | ((uint32_t)wake << GPCWE);
+}
+
+// Inlined into each ISR so ticksPerUs is a constant there
+static IR_INLINE void captureEdge(uint32_t now, uint32_t ticksPerUs) {
+  if (sWakeArmed) {
+    // the level trigger woke the CPU; back to edges before the mark ends
+    setTrigger(CHANGE, false);
+    sWakeArmed = false;
+    sWoke      = true;
+  }
+  uint32_t d = now - sLastEdge;
+  sLastEdge = now;
+  if (sIdle || d > sMaxTicks) {
+    sIdle = false;
+    // silence before this edge: a new frame starts here
+    sIrRing.pushMark(now);
+    schedWake();
+  } else if (d >= sMinTicks) {
+    sIrRing.push(d / ticksPerUs);
+    schedWake();
+  }
+}
+
+static void ICACHE_RAM_ATTR onEdgeMicros() {
+  captureEdge(micros(), 1);
+}
+
+static void ICACHE_RAM_ATTR onEdgeCycles() {
+  captureEdge(ESP.getCycleCount(), CYCLES_PER_US);
+}
+
+// ===== Loop side =====
+static uint32_t ticksNow() {
+  return gBackend == IR_CAPTURE_CCOUNT ? ESP.getCycleCount() : micros();
+}
+
+static uint32_t ticksPerUs() {
+  return gBackend == IR_CAPTURE_CCOUNT ? CYCLES_PER_US : 1;
+}
+
+void irCaptureBegin(IrCaptureBackend backend, uint8_t pin,
+                    uint16_t minPulseUs, uint32_t maxPulseUs) {
+  gBackend  = backend;
+  sMinTicks = minPulseUs * ticksPerUs();
+  sMaxTicks = maxPulseUs * ticksPerUs();
+  sLastEdge = ticksNow();
+  sPin      = pin;
+
+  pinMode(pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(pin),
+                  backend == IR_CAPTURE_CCOUNT ? onEdgeCycles : onEdgeMicros, CHANGE);
+}
+
+void irCapturePoll() {
+  if (sIdle) return;
+  noInterrupts();
+  if (ticksNow() - sLastEdge > sMaxTicks) sIdle = true;
+  interrupts();
+}
+
+bool irCapturePop(uint16_t& us) {
+  if (!sIrRing.pop(us)) return false;
+  if (us == IR_FRAME_MARK) gFrameStart = sIrRing.popStamp();
+  return true;
+}
+
+bool irCaptureOverflowed() {
+  if (!sIrRing.overflow) return false;
+  sIrRing.overflow = false;
+  return true;
+}
+
+bool irCaptureArmWake() {
+  noInterrupts();
+  // a line that is low already would wake at once
+  bool ok = sIdle && digitalRead(sPin) == HIGH;
+  if (ok) {
+    setTrigger(ONLOW, true);
+    sWakeArmed = true;
+  }
+  interrupts();
+  return ok;
+}
+
+void irCaptureDisarmWake() {
+  noInterrupts();
+  if (sWakeArmed) setTrigger(CHANGE, false);
+  sWakeArmed = false;
+  interrupts();
+}
+
+bool irCaptureWoke() {
+  if (!sWoke) return false;
+  sWoke = false;
+  return true;
+}
+
+unsigned long irCaptureFrameStartUs() {
+  // the cycle counter wraps every 53 s at 80 MHz, plenty for a frame that
+  // waited in the ring and is read right after its marker was popped
+  uint32_t ageUs = (ticksNow() - gFrameStart) / ticksPerUs();
+  return micros() - ageUs;
+}
+
+uint32_t irCaptureIdleUs() {
+  return (ticksNow() - sLastEdge) / ticksPerUs();
+}
+
+const char* irCaptureName() {
+  return gBackend == IR_CAPTURE_CCOUNT ? "ccount" : "micros";
+}
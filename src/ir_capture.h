@@ -0,0 +1,66 @@
+/*
+  IR edge capture
+
+  An interrupt on each edge of the receiver output timestamps it and pushes
+  the time since the previous edge into an IrRing; loop() pops durations
+  and feeds them to the decoder, which never sees the capture details.
+
+  Two timestamp sources:
+  - IR_CAPTURE_MICROS: micros(), the original path
+  - IR_CAPTURE_CCOUNT: the CPU cycle counter (12.5 ns at 80 MHz). Reading
+    it is a single register read, so the ISR does less work between entry
+    and taking the stamp and the stamp itself has no rounding.
+
+  The ESP8266 has no input capture or RMT peripheral, so both still stamp
+  from the edge interrupt; use the decoder's jitter stats to compare them.
+
+  Light sleep only wakes on a GPIO level, not an edge. irCaptureArmWake()
+  switches the pin to a low level trigger with wake enabled; the first
+  mark wakes the CPU and the ISR switches straight back to edges, so the
+  rest of the burst is captured as usual. That first edge is stamped
+  after the wake, the header mark comes out short by the wake time.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "ir_ring.h"
+
+const uint16_t IR_RING_SIZE = 256;   // ~3.5 frames, rides out a blocking reconnect
+
+enum IrCaptureBackend : uint8_t {
+  IR_CAPTURE_MICROS,
+  IR_CAPTURE_CCOUNT
+};
+
+// Durations below minPulseUs are dropped as glitches, a gap above
+// maxPulseUs is pushed as IR_FRAME_MARK.
+void irCaptureBegin(IrCaptureBackend backend, uint8_t pin,
+                    uint16_t minPulseUs, uint32_t maxPulseUs);
+
+// Call from loop(). Marks the line idle once the gap is long enough, so the
+// next edge starts a frame even after the tick counter has wrapped.
+void irCapturePoll();
+
+// Next duration in microseconds, or IR_FRAME_MARK
+bool irCapturePop(uint16_t& us);
+
+// True (once) if the ring filled up and edges were lost
+bool irCaptureOverflowed();
+
+// Before light sleep, with the line idle. False if it isn't: stay awake.
+bool irCaptureArmWake();
+void irCaptureDisarmWake();
+
+// True (once) if an IR mark woke the CPU since the last call
+bool irCaptureWoke();
+
+// micros() time of the first edge of the frame whose IR_FRAME_MARK
+// irCapturePop() returned last
+unsigned long irCaptureFrameStartUs();
+
+// Time since the last edge
+uint32_t irCaptureIdleUs();
+
+const char* irCaptureName();
@@ -0,0 +1,78 @@
+/*
+  Single-producer / single-consumer ring for IR edge durations
+
+  The capture ISR pushes, loop() pops. Only the ISR writes head and only loop()
+  writes tail, so neither side needs to disable interrupts. Durations are
+  stored as 16 bit microseconds (the capture window tops out at
+  MAX_PULSE_US); IR_FRAME_MARK is pushed in place of a gap long enough to
+  separate two frames, followed by two entries with the 32 bit stamp of
+  the frame's first edge. With several frames queued each keeps its own.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#define IR_INLINE inline __attribute__((always_inline))
+
+// Only head and tail are volatile, so the compiler could move buf accesses
+// across them. The barrier keeps payload writes before the head that
+// publishes them, and reads after the head check and before the tail that
+// frees their slots. One core: nothing else is needed.
+#define IR_BARRIER() asm volatile("" ::: "memory")
+
+const uint16_t IR_FRAME_MARK = 0;
+
+template <uint16_t N>
+struct IrRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+  uint16_t          buf[N];
+  volatile uint16_t head = 0;       // written by the producer
+  volatile uint16_t tail = 0;       // written by the consumer
+  volatile bool     overflow = false;
+
+  // Must be inlined: it runs from the ISR, which has to stay in IRAM
+  IR_INLINE bool push(uint16_t v) {
+    uint16_t h = head;
+    if ((uint16_t)(h - tail) >= N) { overflow = true; return false; }
+    buf[h & (N - 1)] = v;
+    IR_BARRIER();
+    head = h + 1;
+    return true;
+  }
+
+  // IR_FRAME_MARK and its stamp, all three or none
+  IR_INLINE bool pushMark(uint32_t stamp) {
+    uint16_t h = head;
+    if ((uint16_t)(h - tail) > N - 3) { overflow = true; return false; }
+    buf[h & (N - 1)]       = IR_FRAME_MARK;
+    buf[(h + 1) & (N - 1)] = stamp;
+    buf[(h + 2) & (N - 1)] = stamp >> 16;
+    IR_BARRIER();
+    head = h + 3;
+    return true;
+  }
+
+  IR_INLINE bool pop(uint16_t& v) {
+    uint16_t t = tail;
+    if (t == head) return false;
+    IR_BARRIER();
+    v = buf[t & (N - 1)];
+    IR_BARRIER();
+    tail = t + 1;
+    return true;
+  }
+
+  // Right after pop() returned IR_FRAME_MARK
+  IR_INLINE uint32_t popStamp() {
+    uint16_t t = tail;
+    uint32_t v = buf[t & (N - 1)] | (uint32_t)buf[(t + 1) & (N - 1)] << 16;
+    IR_BARRIER();
+    tail = t + 2;
+    return v;
+  }
+
+  IR_INLINE uint16_t size() const { return (uint16_t)(head - tail); }
+  IR_INLINE void clear() { tail = head; }
+};
@@ -0,0 +1,125 @@
+#include "ir_trace.h"
+
+// ===== Records =====
+enum : uint8_t {
+  TRACE_CUT      = 1 << 0,   // more edges than IR_TRACE_EDGES
+  TRACE_OVERFLOW = 1 << 1    // the capture ring overflowed during the burst
+};
+
+struct IrTraceRecord {
+  uint32_t startUs;
+  uint32_t value;            // NEC_FRAME only
+  uint16_t lagUs;            // last edge to decoder result, saturated
+  uint8_t  event;            // NecEvent, NEC_NONE: unresolved
+  uint8_t  reject;           // NecReject
+  uint8_t  count;
+  uint8_t  flags;
+  uint16_t us[IR_TRACE_EDGES];
+};
+
+// One slot more than is kept: the burst being recorded never overwrites
+// the oldest kept one before it is known whether it will be kept itself
+const uint8_t IR_TRACE_SLOTS = IR_TRACE_RECORDS + 1;
+
+static IrTraceRecord  gRecs[IR_TRACE_SLOTS];
+static uint8_t        gHead  = 0;          // next slot to fill
+static uint8_t        gCount = 0;          // kept records
+static IrTraceRecord* gCur   = nullptr;    // receiving edges
+static bool           gCurKept = false;
+static uint32_t       gCurEndUs = 0;       // start + durations so far
+static IrTraceMode    gMode  = IR_TRACE_OFF;
+
+const size_t kIrTraceRamBytes = sizeof(gRecs);
+
+static void keep() {
+  gCurKept = true;
+  gHead = (gHead + 1) % IR_TRACE_SLOTS;
+  if (gCount < IR_TRACE_RECORDS) gCount++;
+}
+
+// ===== Recording =====
+void irTraceSetMode(IrTraceMode mode) {
+  gMode = mode;
+  gCur  = nullptr;
+}
+
+IrTraceMode irTraceMode() {
+  return gMode;
+}
+
+const char* irTraceModeName(IrTraceMode mode) {
+  switch (mode) {
+    case IR_TRACE_OFF:     return "off";
+    case IR_TRACE_REJECTS: return "rejects";
+    case IR_TRACE_ALL:     return "all";
+  }
+  return "?";
+}
+
+void irTraceStart(unsigned long startUs) {
+  // an unresolved burst (noise that never got far) only counts in full traces
+  if (gCur && !gCurKept && gCur->count > 0 && gMode == IR_TRACE_ALL) keep();
+  if (gMode == IR_TRACE_OFF) { gCur = nullptr; return; }
+
+  gCur = &gRecs[gHead];
+  memset(gCur, 0, offsetof(IrTraceRecord, us));
+  gCur->startUs = startUs;
+  gCurKept  = false;
+  gCurEndUs = startUs;
+}
+
+void irTraceEdge(uint16_t us) {
+  if (!gCur) return;
+  gCurEndUs += us;
+  if (gCur->count < IR_TRACE_EDGES) gCur->us[gCur->count++] = us;
+  else                              gCur->flags |= TRACE_CUT;
+}
+
+void irTraceResult(NecEvent ev, const NecDecoder& d) {
+  if (!gCur || ev == NEC_NONE || gCur->event != NEC_NONE) return;
+  uint32_t lag = micros() - gCurEndUs;
+  gCur->event  = ev;
+  gCur->reject = d.reject;
+  gCur->value  = ev == NEC_FRAME ? d.value : 0;
+  gCur->lagUs  = lag < 0xFFFF ? lag : 0xFFFF;
+  // later edges of the burst (the stop mark) still go into it
+  if (gMode == IR_TRACE_ALL || ev == NEC_REJECT) keep();
+}
+
+void irTraceOverflow() {
+  if (gCur) gCur->flags |= TRACE_OVERFLOW;
+}
+
+// ===== Export =====
+uint8_t irTraceCount() {
+  return gCount;
+}
+
+static void printRecord(Print& out, const IrTraceRecord& r) {
+  out.printf("%lu %u", (unsigned long)r.startUs, r.count);
+  for (uint8_t i = 0; i < r.count; i++) out.printf(" %u", r.us[i]);
+
+  switch (r.event) {
+    case NEC_FRAME:  out.printf(" # frame %08lX", (unsigned long)r.value); break;
+    case NEC_REPEAT: out.printf(" # repeat"); break;
+    case NEC_REJECT: out.printf(" # reject: %s", necRejectName((NecReject)r.reject)); break;
+    default:         out.printf(" # unresolved"); break;
+  }
+  if (r.event != NEC_NONE) out.printf(", lag %u us", r.lagUs);
+  if (r.flags & TRACE_CUT)      out.printf(", cut");
+  if (r.flags & TRACE_OVERFLOW) out.printf(", ring overflow");
+  out.printf("\n");
+}
+
+void irTracePrint(Print& out, uint8_t from, uint8_t count) {
+  out.printf("# IR trace (%s), %u bursts: start us, count, durations\n", irTraceModeName(gMode), gCount);
+  uint8_t oldest = (gHead + IR_TRACE_SLOTS - gCount) % IR_TRACE_SLOTS;
+  for (uint8_t i = from; i < gCount && i - from < count; i++)
+    printRecord(out, gRecs[(oldest + i) % IR_TRACE_SLOTS]);
+}
+
+void irTraceClear() {
+  gHead  = 0;
+  gCount = 0;
+  gCur   = nullptr;
+}
@@ -0,0 +1,55 @@
+/*
+  Raw IR trace
+
+  Keeps the durations of the last IR_TRACE_RECORDS bursts exactly as
+  loop() popped them from the capture ring, each with what the decoder
+  made of it: frame (and its value), repeat or reject (and why). With the
+  mode at IR_TRACE_REJECTS only rejected bursts are kept, so the ones
+  behind a dropped press are still there when someone looks.
+
+  Each record also notes how long after its last edge loop() got to it
+  (lag) and whether the capture ring overflowed meanwhile, which tells a
+  marginal tolerance apart from a loop that was held up by WiFi.
+
+  irTracePrint() writes one line per burst:
+    <start us> <count> <duration us> ... # <result>
+  which the native tests read back with traceParse() (test/host/replay.h)
+  to replay it. Fixed RAM, nothing is allocated.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "nec_decoder.h"
+
+const uint8_t IR_TRACE_RECORDS = 8;
+const uint8_t IR_TRACE_EDGES   = 68;   // header, 32 bits, stop mark and one spare
+
+enum IrTraceMode : uint8_t {
+  IR_TRACE_OFF,
+  IR_TRACE_REJECTS,
+  IR_TRACE_ALL
+};
+
+void        irTraceSetMode(IrTraceMode mode);
+IrTraceMode irTraceMode();
+const char* irTraceModeName(IrTraceMode mode);
+
+// ===== Fed by the ring drain in loop() =====
+// A burst starts (IR_FRAME_MARK popped); startUs is its first edge
+void irTraceStart(unsigned long startUs);
+void irTraceEdge(uint16_t us);
+// Any decoder event; NEC_NONE is ignored
+void irTraceResult(NecEvent ev, const NecDecoder& d);
+// The capture ring lost edges
+void irTraceOverflow();
+
+// ===== Export =====
+uint8_t irTraceCount();
+// count records starting at from (0: the oldest kept)
+void    irTracePrint(Print& out, uint8_t from = 0, uint8_t count = IR_TRACE_RECORDS);
+void    irTraceClear();
+
+// Static record storage
+extern const size_t kIrTraceRamBytes;
@@ -0,0 +1,145 @@
+#include "json_sax.h"
+
+enum SaxState : uint8_t {
+  SAX_IDLE,       // between tokens
+  SAX_STRING,
+  SAX_LITERAL     // number, true, false, null
+};
+
+static void emit(JsonSax& s, JsonEvent ev, uint8_t pathLen) {
+  s.pathLen = pathLen;
+  if (s.fn) s.fn(s, ev, s.ctx);
+}
+
+static void startValue(JsonSax& s, bool isString) {
+  s.valueLen  = 0;
+  s.value[0]  = '\0';
+  s.isString  = isString;
+  s.truncated = false;
+}
+
+static void putValue(JsonSax& s, char c) {
+  if (s.valueLen < JSON_SAX_VALUE - 1) {
+    s.value[s.valueLen++] = c;
+    s.value[s.valueLen] = '\0';
+  } else {
+    s.truncated = true;
+  }
+}
+
+static void putKey(JsonSax& s, char c) {
+  if (s.depth > JSON_SAX_DEPTH) return;
+  char* k = s.key[s.depth - 1];
+  size_t n = strlen(k);
+  if (n < JSON_SAX_KEY - 1) { k[n] = c; k[n + 1] = '\0'; }
+}
+
+static void endValue(JsonSax& s) {
+  if (s.depth > 0 && s.depth <= JSON_SAX_DEPTH) emit(s, JSON_VALUE, s.depth);
+}
+
+void jsonSaxBegin(JsonSax& s, JsonSaxFn fn, void* ctx) {
+  s.fn  = fn;
+  s.ctx = ctx;
+  jsonSaxReset(s);
+}
+
+void jsonSaxReset(JsonSax& s) {
+  s.depth     = 0;
+  s.pathLen   = 0;
+  s.state     = SAX_IDLE;
+  s.esc       = false;
+  s.expectKey = false;
+  startValue(s, false);
+}
+
+bool jsonSaxFeed(JsonSax& s, char c) {
+  if (s.state == SAX_STRING) {
+    bool isKey = s.expectKey;
+    if (s.esc) {
+      // escapes are kept as the bare character, \u sequences as their digits
+      s.esc = false;
+    } else if (c == '\\') {
+      s.esc = true;
+      return false;
+    } else if (c == '"') {
+      s.state = SAX_IDLE;
+      if (isKey) s.expectKey = false;
+      else       endValue(s);
+      return false;
+    }
+    if (isKey) putKey(s, c);
+    else       putValue(s, c);
+    return false;
+  }
+
+  if (s.state == SAX_LITERAL) {
+    bool more = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' ||
+                c == 'E';
+    if (more) { putValue(s, c); return false; }
+    s.state = SAX_IDLE;
+    endValue(s);
+    // c is a delimiter, handled below
+  }
+
+  if (s.depth == 0 && c != '{' && c != '[') return false;
+
+  switch (c) {
+    case '{':
+    case '[':
+      if (s.depth == 0) emit(s, JSON_BEGIN, 0);
+      if (s.depth < JSON_SAX_DEPTH) {
+        s.isArray[s.depth] = (c == '[');
+        s.key[s.depth][0] = '\0';
+      }
+      if (s.depth < 0xFF) s.depth++;
+      s.expectKey = (c == '{');
+      break;
+    case '}':
+    case ']':
+      s.depth--;
+      s.expectKey = false;
+      if (s.depth <= JSON_SAX_DEPTH) emit(s, JSON_END, s.depth);
+      return s.depth == 0;
+    case ',':
+      s.expectKey = s.depth <= JSON_SAX_DEPTH && !s.isArray[s.depth - 1];
+      if (s.expectKey) s.key[s.depth - 1][0] = '\0';
+      break;
+    case '"':
+      s.state = SAX_STRING;
+      s.esc = false;
+      if (!s.expectKey) startValue(s, true);
+      break;
+    case ':':
+    case ' ':
+    case '\t':
+    case '\r':
+    case '\n':
+      break;
+    default:
+      s.state = SAX_LITERAL;
+      startValue(s, false);
+      putValue(s, c);
+      break;
+  }
+  return false;
+}
+
+bool jsonSaxPath(const JsonSax& s, const char* path, uint8_t from) {
+  for (uint8_t i = from; i < s.pathLen; i++) {
+    const char* seg = s.isArray[i] ? "#" : s.key[i];
+    size_t n = strlen(seg);
+    if (strncmp(path, seg, n) != 0) return false;
+    path += n;
+    if (i + 1 < s.pathLen) {
+      if (*path != '.') return false;
+      path++;
+    }
+  }
+  return *path == '\0';
+}
+
+long jsonSaxInt(const JsonSax& s) {
+  if (s.isString) return 0;
+  return strtol(s.value, nullptr, 10);
+}
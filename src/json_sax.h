@@ -0,0 +1,73 @@
+/*
+  Streaming JSON scanner
+
+  Parses JSON one byte at a time without building a document. The caller
+  gets an event for each scalar value and each closing object or array,
+  together with the path that leads to it, and keeps only what it needs.
+  Memory is fixed: the path stack and one value buffer, whatever the size
+  of the message.
+
+  Paths are dotted member names with "#" for an array element, e.g.
+  "result.#.playerid". Levels deeper than JSON_SAX_DEPTH are still
+  scanned, only their values aren't reported. Over-long keys and values
+  are cut short; a cut value has JsonSax::truncated set.
+
+  Bytes outside a top level object or array (whitespace, separators
+  between messages, an HTML error page) are skipped.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+const uint8_t JSON_SAX_DEPTH = 8;
+const uint8_t JSON_SAX_KEY   = 16;   // including the terminator
+const uint8_t JSON_SAX_VALUE = 32;   // including the terminator
+
+enum JsonEvent : uint8_t {
+  JSON_BEGIN,    // a top level message starts
+  JSON_VALUE,    // value holds a string, number, true, false or null
+  JSON_END       // an object or array closed, the path leads to it
+};
+
+struct JsonSax;
+typedef void (*JsonSaxFn)(JsonSax& s, JsonEvent ev, void* ctx);
+
+struct JsonSax {
+  // ===== Path =====
+  uint8_t  depth;                         // open containers
+  uint8_t  pathLen;                       // levels in the path of the event
+  bool     isArray[JSON_SAX_DEPTH];
+  char     key[JSON_SAX_DEPTH][JSON_SAX_KEY];
+
+  // ===== Current value =====
+  char     value[JSON_SAX_VALUE];
+  uint8_t  valueLen;
+  bool     isString;
+  bool     truncated;
+
+  // ===== Lexer =====
+  uint8_t  state;
+  bool     esc;
+  bool     expectKey;
+
+  JsonSaxFn fn;
+  void*     ctx;
+};
+
+void jsonSaxBegin(JsonSax& s, JsonSaxFn fn, void* ctx);
+
+// Drops a half-scanned message, e.g. after the connection broke
+void jsonSaxReset(JsonSax& s);
+
+// Returns true when c closes a top level object or array
+bool jsonSaxFeed(JsonSax& s, char c);
+
+// True while inside a message
+inline bool jsonSaxBusy(const JsonSax& s) { return s.depth > 0; }
+
+// True if the path of the current event, from level `from` on, is path
+bool jsonSaxPath(const JsonSax& s, const char* path, uint8_t from = 0);
+
+// The current value as a number, 0 if it is not one
+long jsonSaxInt(const JsonSax& s);
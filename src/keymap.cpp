@@ -0,0 +1,302 @@
+#include "keymap.h"
+
+#include <LittleFS.h>
+
+#include "kodi_state.h"
+#include "logger.h"
+#include "payloads.h"
+
+// ===== Built-in keymap =====
+// Used when there is no valid /keymap.bin. Same behavior the firmware has
+// always had for the Apple TV 2 remote.
+static const KeyProfile kDefaultProfiles[] = {
+  { "default" }
+};
+
+// Only the 0x87 byte of the vendor address is checked
+static const KeyRemote kDefaultRemotes[] = {
+  { 0x87EE, 0xFF00, "apple" }
+};
+
+enum : uint8_t { D_MENU, D_PLAY_PAUSE, D_UP, D_DOWN, D_LEFT, D_RIGHT, D_SELECT };
+
+static const KeyButton kDefaultButtons[] = {
+  { 0, 0x03, 0, 0, "MENU"       },
+  { 0, 0x5F, 0, 0, "PLAY_PAUSE" },
+  { 0, 0x0A, 0, 0, "UP"         },
+  { 0, 0x0C, 0, 0, "DOWN"       },
+  { 0, 0x09, 0, 0, "LEFT"       },
+  { 0, 0x06, 0, 0, "RIGHT"      },
+  { 0, 0x5C, 0, 0, "SELECT"     }
+};
+
+static const KeyRule kDefaultRules[] = {
+  { D_MENU,       0xFF, KEY_PRESS,  KEY_ALWAYS,          PL_ActBack,        KEY_NONE },
+  { D_PLAY_PAUSE, 0xFF, KEY_HOLD,   KEY_ALWAYS,          PL_WinPowerMenu,   KEY_NONE },
+  { D_PLAY_PAUSE, 0xFF, KEY_TAP,    KEY_ALWAYS,          PL_ActPlayPause,   KEY_NONE },
+  { D_UP,         0xFF, KEY_PRESS,  KEY_ALWAYS,          PL_ActUp,          KEY_NONE },
+  { D_UP,         0xFF, KEY_REPEAT, KEY_ALWAYS,          PL_ActUp,          KEY_NONE },
+  { D_DOWN,       0xFF, KEY_PRESS,  KEY_FOREGROUND,      PL_ActOSD,         KEY_NONE },
+  { D_DOWN,       0xFF, KEY_PRESS,  KEY_ALWAYS,          PL_ActDown,        KEY_NONE },
+  { D_DOWN,       0xFF, KEY_REPEAT, KEY_ALWAYS,          PL_ActDown,        KEY_NONE },
+  { D_LEFT,       0xFF, KEY_DOUBLE, KEY_PLAYER,          PL_ActStepBack,    KEY_NONE },
+  { D_LEFT,       0xFF, KEY_PRESS,  KEY_ALWAYS,          PL_ActLeft,        KEY_NONE },
+  { D_LEFT,       0xFF, KEY_REPEAT, KEY_ALWAYS,          PL_ActLeft,        KEY_NONE },
+  { D_RIGHT,      0xFF, KEY_DOUBLE, KEY_PLAYER,          PL_ActStepFwd,     KEY_NONE },
+  { D_RIGHT,      0xFF, KEY_PRESS,  KEY_ALWAYS,          PL_ActRight,       KEY_NONE },
+  { D_RIGHT,      0xFF, KEY_REPEAT, KEY_ALWAYS,          PL_ActRight,       KEY_NONE },
+  { D_SELECT,     0xFF, KEY_HOLD,   KEY_NOT_FOREGROUND,  PL_ActContextMenu, KEY_NONE },
+  { D_SELECT,     0xFF, KEY_TAP,    KEY_PURE_FULLSCREEN, PL_ActPlayPause,   KEY_NONE },
+  { D_SELECT,     0xFF, KEY_TAP,    KEY_ALWAYS,          PL_ActSelect,      KEY_NONE }
+};
+
+#define COUNT_OF(a) (sizeof(a) / sizeof((a)[0]))
+
+// ===== Loaded keymap =====
+// Two banks: lookups use gMap while keymapStage() loads the other one,
+// and keymapCommit() swaps the pointer between presses
+struct KeymapTables {
+  KeymapHeader hdr;
+  KeyProfile   profiles[KEYMAP_PROFILES_MAX];
+  KeyRemote    remotes[KEYMAP_REMOTES_MAX];
+  KeyButton    buttons[KEYMAP_BUTTONS_MAX];
+  KeyRule      rules[KEYMAP_RULES_MAX];
+
+  // Built after loading
+  uint8_t keyIndex[256];                   // key byte -> first button
+  uint8_t nextSameKey[KEYMAP_BUTTONS_MAX]; // same key on another remote
+  uint8_t ruleFirst[KEYMAP_BUTTONS_MAX];
+  uint8_t ruleCount[KEYMAP_BUTTONS_MAX];
+  uint8_t chordLead[KEYMAP_BUTTONS_MAX];   // profiles with a chord from here
+};
+
+static KeymapTables  gBanks[2];
+static KeymapTables* gMap    = &gBanks[0];
+static KeymapTables* gStaged = nullptr;   // loaded, waiting for keymapCommit()
+
+static uint8_t gProfile = 0;
+
+const size_t kKeymapRamBytes = sizeof(gBanks);
+
+// ===== Loading =====
+static const char* validate(KeymapTables& m) {
+  if (m.hdr.profiles == 0 || m.hdr.remotes == 0) return "no profiles or remotes";
+  for (uint8_t i = 0; i < m.hdr.buttons; i++) {
+    if (m.buttons[i].remote >= m.hdr.remotes) return "button on unknown remote";
+    m.buttons[i].name[KEYMAP_NAME_LEN - 1] = 0;
+    for (uint8_t j = 0; j < i; j++) {
+      if (m.buttons[j].key == m.buttons[i].key && m.buttons[j].remote == m.buttons[i].remote)
+        return "duplicate button";
+    }
+  }
+  for (uint8_t i = 0; i < m.hdr.rules; i++) {
+    const KeyRule& r = m.rules[i];
+    if (r.button >= m.hdr.buttons)                   return "rule on unknown button";
+    if (i > 0 && r.button < m.rules[i - 1].button)   return "rules not sorted by button";
+    if (r.trigger >= KEY_TRIGGERS)                   return "bad trigger";
+    if (r.context >= KEY_CONTEXTS)                   return "bad context";
+    if (r.action >= PL_COUNT && r.action != KEY_ACT_PROFILE_NEXT && r.action != KEY_ACT_TARGET_NEXT)
+      return "bad action";
+    if (r.trigger == KEY_CHORD ? r.partner >= m.hdr.buttons || r.partner == r.button
+                               : r.partner != KEY_NONE) return "bad chord";
+  }
+  for (uint8_t i = 0; i < m.hdr.profiles; i++) m.profiles[i].name[KEYMAP_NAME_LEN - 1] = 0;
+  for (uint8_t i = 0; i < m.hdr.remotes; i++)  m.remotes[i].name[KEYMAP_NAME_LEN - 1] = 0;
+  return nullptr;
+}
+
+static bool readBlock(File& f, void* dst, size_t len) {
+  return f.read((uint8_t*)dst, len) == (int)len;
+}
+
+static const char* loadFile(KeymapTables& m, const char* path) {
+  File f = LittleFS.open(path, "r");
+  if (!f) return "not found";
+
+  const char* err = nullptr;
+  if (!readBlock(f, &m.hdr, sizeof(m.hdr)) || memcmp(m.hdr.magic, "KMAP", 4) != 0) err = "bad header";
+  else if (m.hdr.version != KEYMAP_VERSION) err = "unsupported version";
+  else if (m.hdr.profiles > KEYMAP_PROFILES_MAX || m.hdr.remotes > KEYMAP_REMOTES_MAX ||
+           m.hdr.buttons > KEYMAP_BUTTONS_MAX || m.hdr.rules > KEYMAP_RULES_MAX) err = "too big";
+  else if (f.size() != sizeof(m.hdr) + m.hdr.profiles * sizeof(KeyProfile) +
+                       m.hdr.remotes * sizeof(KeyRemote) + m.hdr.buttons * sizeof(KeyButton) +
+                       m.hdr.rules * sizeof(KeyRule)) err = "size mismatch";
+  else if (!readBlock(f, m.profiles, m.hdr.profiles * sizeof(KeyProfile)) ||
+           !readBlock(f, m.remotes,  m.hdr.remotes  * sizeof(KeyRemote))  ||
+           !readBlock(f, m.buttons,  m.hdr.buttons  * sizeof(KeyButton))  ||
+           !readBlock(f, m.rules,    m.hdr.rules    * sizeof(KeyRule))) err = "short read";
+  else err = validate(m);
+
+  f.close();
+  return err;
+}
+
+static void loadDefaults(KeymapTables& m) {
+  memcpy(m.hdr.magic, "KMAP", 4);
+  m.hdr.version  = KEYMAP_VERSION;
+  m.hdr.profiles = COUNT_OF(kDefaultProfiles);
+  m.hdr.remotes  = COUNT_OF(kDefaultRemotes);
+  m.hdr.buttons  = COUNT_OF(kDefaultButtons);
+  m.hdr.rules    = COUNT_OF(kDefaultRules);
+  memcpy(m.profiles, kDefaultProfiles, sizeof(kDefaultProfiles));
+  memcpy(m.remotes,  kDefaultRemotes,  sizeof(kDefaultRemotes));
+  memcpy(m.buttons,  kDefaultButtons,  sizeof(kDefaultButtons));
+  memcpy(m.rules,    kDefaultRules,    sizeof(kDefaultRules));
+}
+
+static void buildIndex(KeymapTables& m) {
+  memset(m.keyIndex, KEY_NONE, sizeof(m.keyIndex));
+  // walk backwards so each chain runs in file order
+  for (int b = m.hdr.buttons - 1; b >= 0; b--) {
+    m.nextSameKey[b] = m.keyIndex[m.buttons[b].key];
+    m.keyIndex[m.buttons[b].key] = b;
+    m.ruleCount[b] = 0;
+    m.chordLead[b] = 0;
+  }
+  for (int r = m.hdr.rules - 1; r >= 0; r--) {
+    m.ruleFirst[m.rules[r].button] = r;
+    m.ruleCount[m.rules[r].button]++;
+    if (m.rules[r].trigger == KEY_CHORD) m.chordLead[m.rules[r].partner] |= m.rules[r].profiles;
+  }
+}
+
+bool keymapBegin(const char* path) {
+  KeymapTables& m = *gMap;
+  const char* err = LittleFS.begin() ? loadFile(m, path) : "no filesystem";
+  if (err) {
+    LOG_W("keymap %s: %s, using built-in", path, err);
+    loadDefaults(m);
+  } else {
+    LOG_I("keymap %s: %u buttons, %u rules, %u profiles", path,
+          m.hdr.buttons, m.hdr.rules, m.hdr.profiles);
+  }
+  buildIndex(m);
+  gProfile = 0;
+  return !err;
+}
+
+// ===== Reload =====
+const char* keymapStage(const char* path) {
+  gStaged = nullptr;
+  KeymapTables& m = gMap == &gBanks[0] ? gBanks[1] : gBanks[0];
+  const char* err = loadFile(m, path);
+  if (err) return err;
+  buildIndex(m);
+  gStaged = &m;
+  return nullptr;
+}
+
+bool keymapCommit() {
+  if (!gStaged) return false;
+  gMap    = gStaged;
+  gStaged = nullptr;
+  if (gProfile >= gMap->hdr.profiles) gProfile = 0;
+  LOG_I("keymap reloaded: %u buttons, %u rules, %u profiles", gMap->hdr.buttons, gMap->hdr.rules,
+        gMap->hdr.profiles);
+  return true;
+}
+
+// ===== Lookup =====
+uint8_t keymapLookup(uint32_t frame) {
+  uint16_t addr = frame & 0xFFFF;
+  for (uint8_t b = gMap->keyIndex[(frame >> 16) & 0xFF]; b != KEY_NONE; b = gMap->nextSameKey[b]) {
+    const KeyRemote& r = gMap->remotes[gMap->buttons[b].remote];
+    if ((addr & r.mask) == (r.addr & r.mask)) return b;
+  }
+  return KEY_NONE;
+}
+
+static bool contextMatches(uint8_t c) {
+  switch (c) {
+    case KEY_ALWAYS:          return true;
+    case KEY_PLAYER:          return kodiPlayerActive();
+    case KEY_FOREGROUND:      return kodiForeground();
+    case KEY_NOT_FOREGROUND:  return !kodiForeground();
+    case KEY_PURE_FULLSCREEN: return kodiPureFullscreen();
+  }
+  return false;
+}
+
+const KeyRule* keymapMatch(uint8_t button, KeyTrigger trigger, uint8_t partner) {
+  if (button >= gMap->hdr.buttons) return nullptr;
+  uint8_t bit = 1 << gProfile;
+  const KeyRule* r = &gMap->rules[gMap->ruleFirst[button]];
+  for (uint8_t n = gMap->ruleCount[button]; n; n--, r++) {
+    if (r->trigger == trigger && r->partner == partner &&
+        (r->profiles & bit) && contextMatches(r->context)) return r;
+  }
+  return nullptr;
+}
+
+bool keymapChordLead(uint8_t button) {
+  return button < gMap->hdr.buttons && (gMap->chordLead[button] & (1 << gProfile));
+}
+
+uint8_t keymapButtons() {
+  return gMap->hdr.buttons;
+}
+
+const KeyButton& keymapButton(uint8_t button) {
+  return gMap->buttons[button];
+}
+
+const char* keymapButtonName(uint8_t button) {
+  return button < gMap->hdr.buttons ? gMap->buttons[button].name : nullptr;
+}
+
+// ===== Profiles =====
+uint8_t keymapProfile() {
+  return gProfile;
+}
+
+const char* keymapProfileName() {
+  return gMap->profiles[gProfile].name;
+}
+
+void keymapNextProfile() {
+  gProfile = (gProfile + 1) % gMap->hdr.profiles;
+}
+
+// ===== Names =====
+const char* keymapTriggerName(uint8_t t) {
+  static const char* const kNames[KEY_TRIGGERS] = {
+    "press", "double", "hold", "repeat", "tap", "triple", "chord"
+  };
+  return t < KEY_TRIGGERS ? kNames[t] : "?";
+}
+
+const char* keymapContextName(uint8_t c) {
+  static const char* const kNames[KEY_CONTEXTS] = {
+    "always", "player", "fullscreen", "not fullscreen", "pure fullscreen"
+  };
+  return c < KEY_CONTEXTS ? kNames[c] : "?";
+}
+
+const char* keymapActionName(uint8_t a) {
+  if (a < PL_COUNT) return kPayloads[a]->label;
+  if (a == KEY_ACT_PROFILE_NEXT) return "next profile";
+  return a == KEY_ACT_TARGET_NEXT ? "next target" : "?";
+}
+
+void keymapPrint(Print& out) {
+  out.printf("=== Mappings (profile %s) ===\n", keymapProfileName());
+  uint8_t bit = 1 << gProfile;
+  for (uint8_t b = 0; b < gMap->hdr.buttons; b++) {
+    const KeyButton& kb = gMap->buttons[b];
+    out.printf("%-11s", kb.name);
+    if (gMap->hdr.remotes > 1) out.printf(" [%s]", gMap->remotes[kb.remote].name);
+    if (kb.holdMs)  out.printf(" hold %ums", kb.holdMs);
+    if (kb.multiMs) out.printf(" multi %ums", kb.multiMs);
+    const char* sep = " ";
+    for (uint8_t i = 0; i < gMap->ruleCount[b]; i++) {
+      const KeyRule& r = gMap->rules[gMap->ruleFirst[b] + i];
+      if (!(r.profiles & bit)) continue;
+      out.printf("%s%s", sep, keymapTriggerName(r.trigger));
+      if (r.trigger == KEY_CHORD) out.printf(" after %s", gMap->buttons[r.partner].name);
+      if (r.context != KEY_ALWAYS) out.printf(" (%s)", keymapContextName(r.context));
+      out.printf(": %s", keymapActionName(r.action));
+      sep = " | ";
+    }
+    out.println();
+  }
+}
@@ -0,0 +1,147 @@
+/*
+  Keymap
+
+  Which remote key does what lives in data, not code. A keymap lists
+  remotes (NEC address), their buttons (key byte) and rules. A rule binds
+  a button and a trigger to an action, optionally only in some Kodi
+  context and only in some profiles:
+
+    trigger   press, double, triple (presses within the button's multi-tap
+              window), chord (pressed within that window after another
+              given button), hold start, hold repeat, tap (released
+              before the hold started)
+    context   always, player active, fullscreen video, not fullscreen,
+              fullscreen with nothing focused
+    action    a payload id, "next profile" or "next target"
+
+  For one button and trigger the first rule whose context and profile
+  match wins, so specific rules go before catch-alls. Buttons can override
+  the hold delay and the multi-tap window.
+
+  keymapBegin() loads /keymap.bin from LittleFS (see tools/mkkeymap.py
+  for the format) and falls back to the built-in map. Everything is
+  copied into fixed-size flat tables; lookups index a 256 entry key byte
+  table and never allocate. There are two sets of tables: a new file is
+  loaded into the spare one with keymapStage() and keymapCommit() makes
+  it the active one, so a bad file leaves the current map alone.
+
+  Apple remotes put the vendor address 0x87EE in the low 16 bits and the
+  key in bits 16-23, which the rest of the firmware calls addr.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+// ===== Capacity =====
+const uint8_t KEYMAP_REMOTES_MAX  = 4;
+const uint8_t KEYMAP_PROFILES_MAX = 8;    // profile masks are 8 bits
+const uint8_t KEYMAP_BUTTONS_MAX  = 32;
+const uint8_t KEYMAP_RULES_MAX    = 96;
+const uint8_t KEYMAP_NAME_LEN     = 12;   // including the terminator
+
+const uint8_t KEY_NONE = 0xFF;
+
+enum KeyTrigger : uint8_t {
+  KEY_PRESS,
+  KEY_DOUBLE,
+  KEY_HOLD,
+  KEY_REPEAT,
+  KEY_TAP,
+  KEY_TRIPLE,
+  KEY_CHORD,
+  KEY_TRIGGERS
+};
+
+enum KeyContext : uint8_t {
+  KEY_ALWAYS,
+  KEY_PLAYER,            // kodiPlayerActive()
+  KEY_FOREGROUND,        // kodiForeground()
+  KEY_NOT_FOREGROUND,
+  KEY_PURE_FULLSCREEN,   // kodiPureFullscreen()
+  KEY_CONTEXTS
+};
+
+// Actions below PL_COUNT are payload ids
+const uint8_t KEY_ACT_PROFILE_NEXT = 0xFE;
+const uint8_t KEY_ACT_TARGET_NEXT  = 0xFD;   // which Kodi presses go to, see main.cpp
+
+// ===== File records =====
+// Stored as-is in /keymap.bin, little endian, after a KeymapHeader
+struct __attribute__((packed)) KeymapHeader {
+  char    magic[4];      // "KMAP"
+  uint8_t version;
+  uint8_t profiles;
+  uint8_t remotes;
+  uint8_t buttons;
+  uint8_t rules;
+  uint8_t reserved[3];
+};
+
+struct __attribute__((packed)) KeyProfile {
+  char name[KEYMAP_NAME_LEN];
+};
+
+struct __attribute__((packed)) KeyRemote {
+  uint16_t addr;         // low 16 bits of the frame ...
+  uint16_t mask;         // ... compared under this mask
+  char     name[KEYMAP_NAME_LEN];
+};
+
+struct __attribute__((packed)) KeyButton {
+  uint8_t  remote;
+  uint8_t  key;          // bits 16-23 of the frame
+  uint16_t holdMs;       // 0: firmware default
+  uint16_t multiMs;      // 0: firmware default
+  char     name[KEYMAP_NAME_LEN];
+};
+
+// Rules are sorted by button
+struct __attribute__((packed)) KeyRule {
+  uint8_t button;
+  uint8_t profiles;      // bit n: active in profile n
+  uint8_t trigger;       // KeyTrigger
+  uint8_t context;       // KeyContext
+  uint8_t action;
+  uint8_t partner;       // KEY_CHORD: the button pressed first, else KEY_NONE
+};
+
+const uint8_t KEYMAP_VERSION = 2;
+
+// Loads the keymap, returns false if the built-in one is used
+bool        keymapBegin(const char* path);
+
+// Loads path into the spare tables. nullptr when it is ready for
+// keymapCommit(), else what was wrong with it.
+const char* keymapStage(const char* path);
+
+// Switches to the staged keymap; only between presses, since button
+// indexes held by the gesture engine refer to the active one
+bool        keymapCommit();
+
+// Button index for a decoded frame, KEY_NONE if it isn't mapped
+uint8_t     keymapLookup(uint32_t frame);
+
+// First rule for button and trigger that matches the active profile and
+// the current Kodi state, nullptr if none. partner selects the chord.
+const KeyRule* keymapMatch(uint8_t button, KeyTrigger trigger, uint8_t partner = KEY_NONE);
+
+// True if a chord in the active profile starts with this button
+bool        keymapChordLead(uint8_t button);
+
+uint8_t          keymapButtons();
+const KeyButton& keymapButton(uint8_t button);
+const char*      keymapButtonName(uint8_t button);
+
+uint8_t     keymapProfile();
+const char* keymapProfileName();
+void        keymapNextProfile();
+
+const char* keymapTriggerName(uint8_t t);
+const char* keymapContextName(uint8_t c);
+const char* keymapActionName(uint8_t a);
+
+void        keymapPrint(Print& out);
+
+// Both sets of static tables the keymap is loaded into
+extern const size_t kKeymapRamBytes;
@@ -0,0 +1,205 @@
+#include "kodi_state.h"
+
+#include "json_sax.h"
+#include "rpc.h"
+#include "payloads.h"
+#include "timer_wheel.h"
+
+// ===== Timings =====
+const uint32_t RECONCILE_AFTER_ACTION_MS = 250;  // debounce after our own presses
+const uint32_t RECONCILE_AFTER_EVENT_MS  = 400;  // window settles after play/stop
+
+const uint16_t WINDOW_FULLSCREEN_VIDEO = 12005;
+
+// Both reconcile queries go out as one batch
+static const RpcPayload* const kReconcile[] = { &kRpcGetPlayers, &kRpcGetWindowFocus };
+
+static uint32_t        gReconcileMs = 5000;
+static KodiReconcileFn gOnReconcile = nullptr;
+
+// ===== Message scan =====
+// What the scanner picked out of the message being received. It is reset
+// at the start of every message and only applied once the message turns
+// out to be the reconcile reply or a notification.
+struct KodiScan {
+  char     method[32];        // notifications
+  int8_t   notifyPlayer;      // params.data.player.playerid
+
+  bool     players;           // saw the Player.GetActivePlayers result
+  int8_t   firstPlayer;
+  int8_t   videoPlayer;
+  int8_t   itemPlayer;        // result element being scanned
+  bool     itemVideo;
+
+  bool     window;            // saw the GUI.GetProperties result
+  uint16_t windowId;
+  bool     windowFullscreen;
+  bool     controlFocused;
+};
+
+// ===== Targets =====
+// Messages from different targets arrive interleaved, so each has its own scan
+struct TargetState {
+  KodiState state;
+  KodiScan  scan;
+  Timer     reconcileTimer;
+  bool      reconciling;
+};
+
+static TargetState gTarget[RPC_TARGETS_MAX];
+
+KodiState* gKodi = &gTarget[0].state;
+
+// The one rpc is talking to: messages and notifications arrive with their
+// target selected
+static TargetState& cur() {
+  return gTarget[rpcSelected()];
+}
+
+static void scanReset(KodiScan& scan) {
+  memset(&scan, 0, sizeof(scan));
+  scan.notifyPlayer = -1;
+  scan.firstPlayer  = -1;
+  scan.videoPlayer  = -1;
+  scan.itemPlayer   = -1;
+}
+
+static void onMessage(JsonSax& s, JsonEvent ev, void*) {
+  KodiScan& scan = cur().scan;
+  if (ev == JSON_BEGIN) { scanReset(scan); return; }
+
+  // a batch reply nests each response one level down
+  uint8_t from = s.isArray[0] ? 1 : 0;
+
+  if (ev == JSON_END) {
+    if (jsonSaxPath(s, "result.#", from)) {
+      if (scan.firstPlayer < 0) scan.firstPlayer = scan.itemPlayer;
+      if (scan.itemVideo && scan.videoPlayer < 0) scan.videoPlayer = scan.itemPlayer;
+      scan.itemPlayer = -1;
+      scan.itemVideo  = false;
+    } else if (jsonSaxPath(s, "result", from) && s.isArray[s.pathLen]) {
+      scan.players = true;
+    }
+    return;
+  }
+
+  if (jsonSaxPath(s, "result.#.playerid", from)) {
+    scan.itemPlayer = jsonSaxInt(s);
+  } else if (jsonSaxPath(s, "result.#.type", from)) {
+    scan.itemVideo = strcmp(s.value, "video") == 0;
+  } else if (jsonSaxPath(s, "result.currentwindow.id", from)) {
+    scan.window   = true;
+    scan.windowId = jsonSaxInt(s);
+    if (scan.windowId == WINDOW_FULLSCREEN_VIDEO) scan.windowFullscreen = true;
+  } else if (jsonSaxPath(s, "result.currentwindow.name", from)) {
+    if (strcmp(s.value, "fullscreenvideo") == 0) scan.windowFullscreen = true;
+  } else if (jsonSaxPath(s, "result.currentcontrol.type", from) ||
+             jsonSaxPath(s, "result.currentcontrol.label", from)) {
+    if (s.valueLen > 0) scan.controlFocused = true;
+  } else if (jsonSaxPath(s, "method")) {
+    strlcpy(scan.method, s.value, sizeof(scan.method));
+  } else if (jsonSaxPath(s, "params.data.player.playerid")) {
+    scan.notifyPlayer = jsonSaxInt(s);
+  }
+}
+
+// ===== Reconcile =====
+static void scheduleReconcile(TargetState& t, uint32_t inMs) {
+  if (!timerArmed(t.reconcileTimer) || timerRemainingMs(t.reconcileTimer) > inMs)
+    timerArm(t.reconcileTimer, inMs);
+}
+
+// arg: the target
+static void onReconcile(bool ok, uint32_t arg) {
+  TargetState& t = gTarget[arg];
+  const KodiScan& scan = t.scan;
+  t.reconciling = false;
+  if (!ok || !scan.players || !scan.window) return;
+
+  KodiState& k = t.state;
+  bool video = scan.videoPlayer >= 0;
+  k.playerId        = video ? scan.videoPlayer : scan.firstPlayer;
+  k.playerVideo     = video;
+  k.windowId        = scan.windowId;
+  k.fullscreenVideo = scan.windowFullscreen;
+  k.controlFocused  = scan.controlFocused;
+  k.updatedMs       = millis();
+  k.stale           = false;
+  if (gOnReconcile) gOnReconcile();
+}
+
+static void onReconcileTimer(uint32_t arg) {
+  TargetState& t = gTarget[arg];
+  // one at a time; look again once the running one is likely done
+  if (t.reconciling) { timerArm(t.reconcileTimer, RECONCILE_AFTER_ACTION_MS); return; }
+  timerArm(t.reconcileTimer, gReconcileMs);
+  RpcScope at(arg);
+  t.reconciling = rpcEnqueueBatch(kReconcile, sizeof(kReconcile) / sizeof(kReconcile[0]), onReconcile, arg);
+}
+
+void kodiStateBegin(uint8_t targets, uint32_t reconcileMs) {
+  gReconcileMs = reconcileMs;
+  for (uint8_t i = 0; i < RPC_TARGETS_MAX; i++) {
+    TargetState& t = gTarget[i];
+    t.state = { -1, false, 0, false, false, false, 0, 0, false };
+    scanReset(t.scan);
+    timerInit(t.reconcileTimer, onReconcileTimer, i);
+    if (i < targets) timerArm(t.reconcileTimer, 0);
+  }
+  rpcSetMessageHandler(onMessage);
+}
+
+KodiState& kodiState(uint8_t target) {
+  return gTarget[target < RPC_TARGETS_MAX ? target : 0].state;
+}
+
+void kodiSelect(uint8_t target) {
+  gKodi = &kodiState(target);
+}
+
+void kodiStateTouch() {
+  // debounced, so a held key doesn't interleave reconciles with its repeats
+  timerArm(cur().reconcileTimer, RECONCILE_AFTER_ACTION_MS);
+}
+
+void kodiStateRefresh() {
+  scheduleReconcile(cur(), 0);
+}
+
+void kodiSetReconcileHandler(KodiReconcileFn fn) {
+  gOnReconcile = fn;
+}
+
+// ===== Notifications =====
+// The context changed under us; the window is only certain after the reconcile
+static void changed(TargetState& t) {
+  t.state.events++;
+  t.state.stale = true;
+  scheduleReconcile(t, RECONCILE_AFTER_EVENT_MS);
+}
+
+void kodiOnNotification() {
+  TargetState& t = cur();
+  KodiState& k = t.state;
+  const KodiScan& scan = t.scan;
+  const char* method = scan.method;
+  if (strncmp(method, "Player.", 7) == 0) {
+    const char* ev = method + 7;
+    bool started = strcmp(ev, "OnPlay") == 0 || strcmp(ev, "OnAVStart") == 0;
+    if (started || strcmp(ev, "OnPause") == 0 || strcmp(ev, "OnResume") == 0) {
+      k.playerId = scan.notifyPlayer >= 0 ? scan.notifyPlayer : 0;
+      // playback start usually switches to fullscreen, confirm once it has
+      if (started) changed(t);
+    } else if (strcmp(ev, "OnStop") == 0) {
+      k.playerId = -1;
+      k.playerVideo = false;
+      k.fullscreenVideo = false;
+      changed(t);
+    }
+  } else if (strcmp(method, "GUI.OnScreensaverActivated") == 0) {
+    k.screensaver = true;
+  } else if (strcmp(method, "GUI.OnScreensaverDeactivated") == 0) {
+    k.screensaver = false;
+    changed(t);
+  }
+}
@@ -0,0 +1,71 @@
+/*
+  Cached Kodi state
+
+  Button handlers used to ask Kodi what it is showing before every
+  context-dependent action. Instead this module keeps a local copy of the
+  bits they need (active player, current window, focused control):
+  - Player.* and GUI.OnScreensaver* notifications on the TCP socket update
+    it as they arrive
+  - a reconcile (Player.GetActivePlayers + GUI.GetProperties, sent as one
+    JSON-RPC batch so it costs a single round trip) runs shortly
+    after our own actions, after notifications that change the window, and
+    periodically as a backup; over HTTP it is the only source
+
+  Replies and notifications are never buffered or parsed into a document:
+  kodiStateBegin() hooks a streaming scanner into rpc that keeps only
+  player ids and types, the window and the focused control, so memory use
+  doesn't depend on the size of what Kodi sends (long labels, item
+  metadata, many players).
+
+  Every rpc target has its own copy, fed by its own socket. gKodi points
+  at the one context rules are matched against; kodiSelect() moves it.
+
+  Context checks are then plain memory reads.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+struct KodiState {
+  int8_t        playerId;        // -1: nothing playing
+  bool          playerVideo;
+  uint16_t      windowId;        // 0: unknown
+  bool          fullscreenVideo;
+  bool          controlFocused;
+  bool          screensaver;
+  unsigned long updatedMs;       // last reconcile reply, 0: never
+  uint16_t      events;          // context-changing notifications so far
+  bool          stale;           // one came in, the reconcile after it is pending
+};
+
+extern KodiState* gKodi;
+
+// targets: how many rpc targets to follow. reconcileMs: periodic backup
+// interval. Reconciles run from the timer wheel.
+void kodiStateBegin(uint8_t targets, uint32_t reconcileMs);
+
+// The cached state of an rpc target
+KodiState& kodiState(uint8_t target);
+
+// Points gKodi at target's state
+void kodiSelect(uint8_t target);
+
+// Our own action on the selected rpc target may have changed its window,
+// check again shortly
+void kodiStateTouch();
+
+// Handler for rpcSetNotifyHandler()
+void kodiOnNotification();
+
+// Reconcile the selected rpc target as soon as possible
+void kodiStateRefresh();
+
+// Called after each reconcile reply has been applied, with its rpc target
+// selected
+typedef void (*KodiReconcileFn)();
+void kodiSetReconcileHandler(KodiReconcileFn fn);
+
+inline bool kodiPlayerActive()   { return gKodi->playerId >= 0; }
+inline bool kodiForeground()     { return kodiPlayerActive() && gKodi->fullscreenVideo; }
+inline bool kodiPureFullscreen() { return kodiForeground() && !gKodi->controlFocused; }
@@ -0,0 +1,169 @@
+#include "latency.h"
+
+// ===== Histogram =====
+// Log-linear buckets: LAT_SUB buckets per power of two from 2^LAT_MIN_SHIFT us
+// up, so the relative error stays around 20% from 16 us to half a second.
+const uint8_t LAT_MIN_SHIFT = 4;
+const uint8_t LAT_OCTAVES   = 15;
+const uint8_t LAT_SUB_BITS  = 2;
+const uint8_t LAT_SUB       = 1 << LAT_SUB_BITS;
+const uint8_t LAT_BUCKETS   = LAT_OCTAVES * LAT_SUB + 1;  // bucket 0 catches everything below
+const uint8_t LAT_TRACES    = 8;
+
+struct LatHistogram {
+  uint16_t bucket[LAT_BUCKETS];
+  uint32_t count;
+  uint32_t maxUs;
+};
+
+struct LatTrace {
+  LatToken token;
+  uint8_t  button;
+  bool     queued;
+  bool     written;
+  bool     woke;
+  uint32_t wakeUs;
+  uint32_t edgeUs;
+  uint32_t readyUs;
+  uint32_t decodedUs;
+  uint32_t queuedUs;
+  uint32_t writtenUs;
+};
+
+static LatHistogram gStage[LAT_STAGES];
+static LatHistogram gButton[LAT_BUTTONS_MAX];
+static LatTrace     gTraces[LAT_TRACES];
+static uint16_t     gSeq = 0;
+static LatToken     gActive = 0;
+
+const size_t kLatencyRamBytes = sizeof(gStage) + sizeof(gButton) + sizeof(gTraces);
+
+static const char* const kStageNames[LAT_STAGES] = {
+  "capture", "decode", "dispatch", "queue", "kodi", "total", "wake"
+};
+
+static uint8_t bucketOf(uint32_t us) {
+  if (us < (1UL << LAT_MIN_SHIFT)) return 0;
+  uint8_t msb = 31 - __builtin_clz(us);
+  uint8_t octave = msb - LAT_MIN_SHIFT;
+  if (octave >= LAT_OCTAVES) return LAT_BUCKETS - 1;
+  uint8_t sub = (us >> (msb - LAT_SUB_BITS)) & (LAT_SUB - 1);
+  return 1 + octave * LAT_SUB + sub;
+}
+
+// Upper bound of a bucket in microseconds
+static uint32_t bucketLimit(uint8_t b) {
+  if (b == 0) return 1UL << LAT_MIN_SHIFT;
+  uint8_t octave = (b - 1) / LAT_SUB;
+  uint8_t sub    = (b - 1) % LAT_SUB;
+  uint32_t base  = 1UL << (octave + LAT_MIN_SHIFT);
+  return base + (base >> LAT_SUB_BITS) * (sub + 1);
+}
+
+static void record(LatHistogram& h, uint32_t us) {
+  uint8_t b = bucketOf(us);
+  if (h.bucket[b] < 0xFFFF) h.bucket[b]++;
+  h.count++;
+  if (us > h.maxUs) h.maxUs = us;
+}
+
+static uint32_t percentile(const LatHistogram& h, uint8_t pct) {
+  if (h.count == 0) return 0;
+  uint32_t rank = (h.count * pct + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < LAT_BUCKETS; b++) {
+    seen += h.bucket[b];
+    if (seen >= rank) {
+      uint32_t lim = bucketLimit(b);
+      return lim < h.maxUs ? lim : h.maxUs;
+    }
+  }
+  return h.maxUs;
+}
+
+static LatTrace* find(LatToken t) {
+  if (t == 0) return nullptr;
+  LatTrace& tr = gTraces[t % LAT_TRACES];
+  return tr.token == t ? &tr : nullptr;
+}
+
+// ===== Public API =====
+LatToken latencyBegin(uint8_t button, uint32_t edgeUs, uint32_t readyUs, uint32_t decodedUs) {
+  if (++gSeq == 0) gSeq = 1;
+  LatTrace& tr = gTraces[gSeq % LAT_TRACES];
+  tr.token     = gSeq;
+  tr.button    = button;
+  tr.queued    = false;
+  tr.written   = false;
+  tr.woke      = false;
+  tr.edgeUs    = edgeUs;
+  tr.readyUs   = readyUs;
+  tr.decodedUs = decodedUs;
+  return gSeq;
+}
+
+void latencyWoke(LatToken t, uint32_t wakeUs) {
+  LatTrace* tr = find(t);
+  if (!tr) return;
+  tr->woke   = true;
+  tr->wakeUs = wakeUs;
+}
+
+void latencySetActive(LatToken t) {
+  gActive = t;
+}
+
+LatToken latencyActive() {
+  return gActive;
+}
+
+void latencyQueued(LatToken t) {
+  LatTrace* tr = find(t);
+  if (!tr || tr->queued) return;
+  tr->queued = true;
+  tr->queuedUs = micros();
+}
+
+void latencyWritten(LatToken t) {
+  LatTrace* tr = find(t);
+  if (!tr || !tr->queued || tr->written) return;
+  tr->written = true;
+  tr->writtenUs = micros();
+}
+
+void latencyReplied(LatToken t, bool ok) {
+  LatTrace* tr = find(t);
+  if (!tr || !tr->written) return;
+  tr->token = 0;
+  if (!ok) return;
+
+  uint32_t now = micros();
+  record(gStage[LAT_CAPTURE],  tr->readyUs   - tr->edgeUs);
+  record(gStage[LAT_DECODE],   tr->decodedUs - tr->readyUs);
+  record(gStage[LAT_DISPATCH], tr->queuedUs  - tr->decodedUs);
+  record(gStage[LAT_QUEUE],    tr->writtenUs - tr->queuedUs);
+  record(gStage[LAT_KODI],     now           - tr->writtenUs);
+  record(gStage[LAT_TOTAL],    now           - tr->edgeUs);
+  if (tr->woke) record(gStage[LAT_WAKE], tr->queuedUs - tr->wakeUs);
+  if (tr->button < LAT_BUTTONS_MAX) record(gButton[tr->button], now - tr->edgeUs);
+}
+
+static void printRow(Print& out, const char* name, const LatHistogram& h) {
+  out.printf("%-11s %6lu %8lu %8lu %8lu %8lu\n", name, (unsigned long)h.count,
+             (unsigned long)percentile(h, 50), (unsigned long)percentile(h, 95),
+             (unsigned long)percentile(h, 99), (unsigned long)h.maxUs);
+}
+
+void latencyPrint(Print& out, LatNameFn buttonName) {
+  out.printf("%-11s %6s %8s %8s %8s %8s\n", "latency us", "n", "p50", "p95", "p99", "max");
+  for (uint8_t s = 0; s < LAT_STAGES; s++) printRow(out, kStageNames[s], gStage[s]);
+  for (uint8_t b = 0; b < LAT_BUTTONS_MAX; b++) {
+    const char* name = buttonName(b);
+    if (name && gButton[b].count) printRow(out, name, gButton[b]);
+  }
+}
+
+void latencyReset() {
+  memset(gStage, 0, sizeof(gStage));
+  memset(gButton, 0, sizeof(gButton));
+}
@@ -0,0 +1,53 @@
+/*
+  Key press latency instrumentation
+
+  Each decoded press gets a trace token that follows its RPC through the
+  send queue. Timestamps are taken at the first IR edge, frame ready,
+  decode done, dispatch (first request queued), request written and reply
+  received. On reply the deltas go into fixed-bucket histograms, one per
+  stage plus one end-to-end histogram per button, so percentiles come out
+  without keeping raw samples.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+enum LatStage : uint8_t {
+  LAT_CAPTURE,    // first edge -> frame ready (frame length + idle timeout)
+  LAT_DECODE,     // frame ready -> decoded
+  LAT_DISPATCH,   // decoded -> first request queued
+  LAT_QUEUE,      // queued -> written to the socket
+  LAT_KODI,       // written -> reply received
+  LAT_TOTAL,      // first edge -> reply received
+  LAT_WAKE,       // woken from light sleep -> first request queued, waking presses only
+  LAT_STAGES
+};
+
+const uint8_t LAT_BUTTONS_MAX = 16;
+
+// 0 means "no trace"
+typedef uint16_t LatToken;
+
+// Starts a trace for a decoded frame.
+LatToken latencyBegin(uint8_t button, uint32_t edgeUs, uint32_t readyUs, uint32_t decodedUs);
+
+// The press woke the CPU at wakeUs (the first edge, stamped after the wake)
+void     latencyWoke(LatToken t, uint32_t wakeUs);
+
+// The trace requests queued now belong to; set around press/release handling.
+void     latencySetActive(LatToken t);
+LatToken latencyActive();
+
+// Called by the transport. Only the first request of a trace is measured.
+void     latencyQueued(LatToken t);
+void     latencyWritten(LatToken t);
+void     latencyReplied(LatToken t, bool ok);
+
+// buttonName(i) labels the per-button histogram i, nullptr skips it
+typedef const char* (*LatNameFn)(uint8_t button);
+void     latencyPrint(Print& out, LatNameFn buttonName);
+void     latencyReset();
+
+// Static histogram and trace storage
+extern const size_t kLatencyRamBytes;
@@ -0,0 +1,115 @@
+#include "logger.h"
+
+static_assert((LOG_RING_BYTES & (LOG_RING_BYTES - 1)) == 0, "LOG_RING_BYTES must be a power of two");
+
+// ===== Ring =====
+// Records of [level][length][text], no terminator. Indices run freely and
+// are masked on access; only logPrintf() moves gHead, only the drain gTail.
+static uint8_t  gRing[LOG_RING_BYTES];
+static uint16_t gHead = 0;
+static uint16_t gTail = 0;
+
+// The line being written to Serial, with its newline
+static char    gOut[LOG_LINE_MAX + 1];
+static uint8_t gOutLen = 0;
+static uint8_t gOutOff = 0;
+
+static LogSinkFn gSink = nullptr;
+
+// ===== Stats =====
+static uint32_t gLines       = 0;
+static uint32_t gDropped     = 0;
+static uint16_t gDropPending = 0;   // not reported yet
+static uint16_t gMaxUsed     = 0;
+
+const size_t kLogRamBytes = sizeof(gRing) + sizeof(gOut);
+
+static uint16_t used() {
+  return (uint16_t)(gHead - gTail);
+}
+
+static void dropped() {
+  if (gDropPending < 0xFFFF) gDropPending++;
+  gDropped++;
+}
+
+static bool push(uint8_t level, const char* text, size_t len) {
+  if (LOG_RING_BYTES - used() < len + 2) return false;
+  gRing[gHead++ & (LOG_RING_BYTES - 1)] = level;
+  gRing[gHead++ & (LOG_RING_BYTES - 1)] = len;
+  for (size_t i = 0; i < len; i++) gRing[gHead++ & (LOG_RING_BYTES - 1)] = text[i];
+  if (used() > gMaxUsed) gMaxUsed = used();
+  gLines++;
+  return true;
+}
+
+// Next record into gOut, handed to the sink on the way
+static bool pop() {
+  if (gHead == gTail) return false;
+  uint8_t level = gRing[gTail++ & (LOG_RING_BYTES - 1)];
+  uint8_t len   = gRing[gTail++ & (LOG_RING_BYTES - 1)];
+  for (uint8_t i = 0; i < len; i++) gOut[i] = gRing[gTail++ & (LOG_RING_BYTES - 1)];
+  gOut[len] = '\0';
+  if (gSink) gSink(level, gOut);
+  gOut[len] = '\n';
+  gOutLen   = len + 1;
+  gOutOff   = 0;
+  return true;
+}
+
+// ===== Public =====
+void logPrintf(uint8_t level, const char* fmt, ...) {
+  char line[LOG_LINE_MAX];
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (n < 0) return;
+  size_t len = (size_t)n < sizeof(line) ? n : sizeof(line) - 1;
+  // the lines are written with their own newline
+  while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+
+  // the gap goes in where it happened, before anything newer, once the
+  // line after it fits too
+  if (gDropPending) {
+    char note[40];
+    int m = snprintf(note, sizeof(note), "(%u log lines dropped)", gDropPending);
+    if (LOG_RING_BYTES - used() < m + 2 + len + 2) { dropped(); return; }
+    push(LOG_LEVEL_WARN, note, m);
+    gDropPending = 0;
+  }
+  if (!push(level, line, len)) dropped();
+}
+
+void logSetSink(LogSinkFn fn) {
+  gSink = fn;
+}
+
+void logPoll() {
+  int room = Serial.availableForWrite();
+  while (room > 0) {
+    if (gOutOff == gOutLen && !pop()) return;
+    size_t n = gOutLen - gOutOff;
+    if (n > (size_t)room) n = room;
+    Serial.write((const uint8_t*)gOut + gOutOff, n);
+    gOutOff += n;
+    room    -= n;
+  }
+}
+
+void logFlush() {
+  do {
+    if (gOutOff < gOutLen) Serial.write((const uint8_t*)gOut + gOutOff, gOutLen - gOutOff);
+    gOutOff = gOutLen;
+  } while (pop());
+}
+
+bool logPending() {
+  return gOutOff < gOutLen || gHead != gTail;
+}
+
+void logPrint(Print& out) {
+  out.printf("=== Log (level %u) ===\n", LOG_LEVEL);
+  out.printf("lines %lu, dropped %lu, ring %u/%u bytes (max %u)\n", (unsigned long)gLines,
+             (unsigned long)gDropped, used(), (unsigned)LOG_RING_BYTES, gMaxUsed);
+}
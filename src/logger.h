@@ -0,0 +1,83 @@
+/*
+  Buffered logging
+
+  A Serial.printf() at 115200 baud waits for the UART once its 128 byte
+  FIFO is full, about 87 us per byte after that, and the lines that
+  matter most (frames, holds, RPC errors) are printed right between the
+  decode and the request going out. LOG_E() ... LOG_D() format into a
+  byte ring instead and return; logPoll() moves what the UART FIFO has
+  room for when loop() has nothing else to do, so a line never waits
+  for the wire.
+
+  Levels above LOG_LEVEL compile to nothing, arguments included, so
+  build_flags = -DLOG_LEVEL=LOG_LEVEL_INFO leaves the per-frame lines
+  out of the firmware. When the ring is full new lines are dropped and
+  counted, and a line saying how many comes out once there is room: a
+  burst of logging costs lines, never time.
+
+  Only loop() context logs (never the IR interrupt), which makes the
+  ring single producer, single consumer and needs no locking. A sink set
+  with logSetSink() gets every line as it leaves the ring, see syslog.h.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4   // per frame and per hold
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+const size_t LOG_RING_BYTES = 2048;   // power of two
+const size_t LOG_LINE_MAX   = 120;    // longer lines are cut
+
+// Called with each line as it is drained, without the newline
+typedef void (*LogSinkFn)(uint8_t level, const char* line);
+
+void logPrintf(uint8_t level, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Never runs, but the format is still checked and the arguments count as used
+#define LOG_OFF(...) do { if (0) logPrintf(LOG_LEVEL_NONE, __VA_ARGS__); } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(...) logPrintf(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_E(...) LOG_OFF(__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(...) logPrintf(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_W(...) LOG_OFF(__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(...) logPrintf(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_I(...) LOG_OFF(__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(...) logPrintf(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_D(...) LOG_OFF(__VA_ARGS__)
+#endif
+
+void logSetSink(LogSinkFn fn);
+
+// Writes what Serial takes without waiting; call when idle
+void logPoll();
+
+// Writes everything, waiting for the UART. Before printing to Serial
+// directly, so the dump comes out after the lines logged before it.
+void logFlush();
+
+bool logPending();
+
+void logPrint(Print& out);
+
+// Ring and the line being written
+extern const size_t kLogRamBytes;
@@ -6,371 +6,597 @@
 */
 
 #include <ESP8266WiFi.h>
-#include <ESP8266HTTPClient.h>
-#include <WiFiClient.h>
-#include <ArduinoJson.h>
-#include <base64.h>
+
+#include "rpc.h"
+#include "payloads.h"
+#include "kodi_state.h"
+#include "latency.h"
+#include "web.h"
+#include "ir_capture.h"
+#include "nec_decoder.h"
+#include "ir_trace.h"
+#include "keymap.h"
+#include "gesture.h"
+#include "timer_wheel.h"
+#include "mem_stats.h"
+#include "wifi_link.h"
+#include "discovery.h"
+#include "speculate.h"
+#include "event_client.h"
+#include "metrics.h"
+#include "logger.h"
+#include "syslog.h"
+#include "sched.h"
+#include "power.h"
+#include "settings.h"
+#include "ota.h"
 
 // ===== Pin configuration =====
 #define IR_PIN 14  // D5 on most ESP8266 boards
 
 // ===== NEC capture timing (microseconds) =====
-#define SAMPLE_SIZE        200
+// IR_CAPTURE_CCOUNT stamps edges with the cycle counter, IR_CAPTURE_MICROS
+// with micros(). Compare their jitter in /stats before tightening the tolerance.
+const IrCaptureBackend IR_CAPTURE = IR_CAPTURE_CCOUNT;
 #define MIN_PULSE_US        40
 #define MAX_PULSE_US     24000
-#define IDLE_TIMEOUT_US  50000
-#define NEC_HDR_MARK_US    9000
-#define NEC_HDR_SPACE_US   4500
-#define NEC_BIT_MARK_US     560
-#define NEC_ONE_SPACE_US   1690
-#define NEC_ZERO_SPACE_US   560
+#define IDLE_TIMEOUT_US  50000  // ends a frame that stopped mid-way
 #define NEC_TOLERANCE_US    220
 
+// ===== IR trace =====
+// Raw durations of the last bursts, for tuning NEC_TOLERANCE_US and
+// IDLE_TIMEOUT_US from real remotes: IR_TRACE_REJECTS keeps only the ones
+// the decoder gave up on, IR_TRACE_ALL every one. GET /trace or 't' over
+// serial dumps them; /trace?mode=off|rejects|all or 'T' changes the mode.
+const IrTraceMode IR_TRACE_MODE = IR_TRACE_REJECTS;
+const uint8_t     IR_TRACE_PAGE = 4;   // bursts per /trace response
+
 // ===== WiFi and Kodi configuration =====
 const char* WIFI_SSID   = "yourssid";
 const char* WIFI_PASS   = "yourpass";
-const char* KODI_HOST   = "10.0.1.26";
-const int   KODI_PORT   = 8080;
+// 0.0.0.0 reuses the last DHCP lease for fast joins, or set a fixed address
+const IPAddress WIFI_IP      (0, 0, 0, 0);
+const IPAddress WIFI_GATEWAY (0, 0, 0, 0);
+const IPAddress WIFI_SUBNET  (255, 255, 255, 0);
+const IPAddress WIFI_DNS     (0, 0, 0, 0);
+const uint32_t  WIFI_FAST_TIMEOUT_MS = 3000;   // saved BSSID/channel, static address
+const uint32_t  WIFI_FULL_TIMEOUT_MS = 20000;  // scan and DHCP
+// RPC_HTTP posts to each target's port. RPC_TCP uses the raw socket on its
+// tcpPort and pipelines requests, which keeps up better with hold repeat.
+const RpcTransport KODI_TRANSPORT = RPC_HTTP;
 const bool  KODI_AUTH   = false;
 const char* KODI_USER   = "kodi";
 const char* KODI_PASS   = "kodi";
 
+// ===== Kodi targets =====
+// Every box gets its own persistent connection and state cache, at most
+// RPC_TARGETS_MAX. The first one's host may be "" to only use discovered
+// boxes; discovery and failover drive that one.
+struct KodiTarget {
+  const char* name;
+  const char* host;
+  uint16_t    port;      // HTTP
+  uint16_t    tcpPort;   // raw JSON-RPC socket
+};
+
+const KodiTarget kTargets[] = {
+  { "tv",        "10.0.1.26", 8080, 9090 },
+  // { "projector", "10.0.1.27", 8080, 9090 },
+};
+const uint8_t KODI_TARGETS = sizeof(kTargets) / sizeof(kTargets[0]);
+static_assert(KODI_TARGETS <= RPC_TARGETS_MAX, "raise RPC_TARGETS_MAX in rpc.h");
+
+// ===== Target selection =====
+// TARGET_AUTO sends presses to the target that is playing, or to the last
+// one that was when none or several are. TARGET_ALL sends them to every
+// target, each matched against its own context, so PLAY toggles them all.
+// next-target in the keymap (PLAY then MENU in tools/keymap.txt) or 'n'
+// over serial cycles auto, each target, all.
+const uint8_t TARGET_AUTO  = 0xFE;
+const uint8_t TARGET_ALL   = 0xFF;
+const uint8_t TARGET_START = TARGET_AUTO;
+
+// ===== Live settings =====
+// The UX timings, NEC_TOLERANCE_US, the targets' addresses and the WiFi
+// credentials here are defaults. GET /config lists what is in use,
+// /config?hold_ms=300&host1=10.0.1.27 changes it between two presses
+// without touching the Kodi connections (a new address reconnects that
+// target only) and keeps it in /config.txt. /config?keymap reloads
+// /keymap.bin the same way, ?reset goes back to the defaults. WiFi
+// changes apply at the next boot. 'c' over serial lists them too.
+
+// ===== OTA updates =====
+// pio run -e ota -t upload, see platformio.ini. "" accepts any upload.
+const char*    OTA_PASSWORD = "atv2kodi";
+const uint16_t OTA_PORT     = 8266;
+
+// ===== Kodi discovery =====
+// Boxes announcing JSON-RPC over mDNS become failover candidates next to
+// the first target's host; after KODI_FAILOVER_AFTER failed connects or timeouts in a row
+// the next one is used
+const bool    KODI_DISCOVER        = true;
+const char*   MDNS_HOSTNAME        = "atv2kodi";
+const uint8_t KODI_FAILOVER_AFTER  = 3;
+
 // ===== UX timings =====
-const uint32_t HOLD_DELAY_MS      = 250;  
-const uint32_t REPEAT_RATE_MS     = 110;  
-const uint32_t RELEASE_TIMEOUT_MS = 220;  
-const uint32_t DOUBLECLICK_MS     = 300;  
+// Hold delay and multi-tap window are defaults, keymap buttons can override them
+const uint32_t HOLD_DELAY_MS      = 250;
+const uint32_t REPEAT_RATE_MS     = 110;
+const uint32_t DOUBLECLICK_MS     = 300;  // also the chord window
 const uint32_t HTTP_TIMEOUT_MS    = 300;
 
-// ===== JSON buffer sizes =====
-const size_t JSON_SMALL = 256;
-const size_t JSON_MED   = 512;
-
-// ===== IR capture state (ISR filled) =====
-volatile unsigned long sTimings[SAMPLE_SIZE];
-volatile int           sTimingIdx = 0;
-volatile unsigned long sLastEdgeUs = 0;
-volatile bool          sCapturing = false;
-volatile bool          sFrameReady = false;
-
-// ===== Button and hold state =====
-static const char*  gPressedName = nullptr;
-static unsigned long gPressStartMs = 0;
-static unsigned long gLastRepeatMs = 0;
-static bool          gHoldActive   = false;
-
-// one shot flags for holds
-static bool gPlayPauseHoldDone = false;
-static bool gSelectHoldDone    = false;
-
-// double click memory
-static unsigned long gLastLeftMs  = 0;
-static unsigned long gLastRightMs = 0;
-
-// ===== Networking =====
-WiFiClient gWifi;
-HTTPClient gHttp;
-bool gHttpInitialized = false;
-
-// ===== Key map =====
-struct IRButton {
-  uint8_t addr;
-  uint8_t cmd;
-  const char* name;
-  const char* shortAction;  
-  bool holdRepeat;      
+// ===== Hold / release =====
+// A held key repeats every ~108 ms. The period is measured per hold and the
+// key counts as released once no repeat came within RELEASE_WINDOW_PCT of it.
+const uint16_t RELEASE_WINDOW_PCT = 160;
+
+// ===== Hold repeat acceleration =====
+// Steps per repeat double every REPEAT_ACCEL_MS held, up to REPEAT_STEPS_MAX.
+// At full speed UP/DOWN send page up/down instead. Steps that pile up while
+// Kodi is busy are merged into one batch request.
+const uint16_t REPEAT_ACCEL_MS   = 1000;
+const uint8_t  REPEAT_STEPS_MAX  = 8;
+const uint8_t  REPEAT_PAGE_STEPS = 8;
+
+// ===== Speculative actions =====
+// Context rules use the cached Kodi state and go out at once. If that state
+// turns out to have been stale, the wrong action is taken back with its
+// entry here and the right one is sent. Toggles undo themselves.
+const SpecUndo kSpecUndo[] = {
+  { PL_ActPlayPause, PL_ActPlayPause },
+  { PL_ActOSD,       PL_ActOSD       },
+  { PL_ActDown,      PL_ActUp        }
 };
 
-IRButton kButtons[] = {
-  {0x03, 0x87, "MENU",       "back",      false},
-  {0x5F, 0x87, "PLAY_PAUSE", "playpause", false}, 
-  {0x0A, 0x87, "UP",         "up",        true },
-  {0x0C, 0x87, "DOWN",       "down",      true },
-  {0x09, 0x87, "LEFT",       "left",      true },
-  {0x06, 0x87, "RIGHT",      "right",     true },
-  {0x5C, 0x87, "SELECT",     "select",    false} 
+// ===== Kodi EventServer =====
+// With KODI_EVENTS, actions listed here go out as EventServer buttons (one
+// UDP datagram, no connection, no JSON) when their rule doesn't depend on
+// the context. A held key is a single "down" and Kodi repeats it at its own
+// rate until "up", which takes the place of hold acceleration and page
+// steps. JSON-RPC stays up for the context and the other actions. Needs
+// "Allow remote control from applications on other systems" in Kodi.
+const bool     KODI_EVENTS     = false;
+const uint16_t KODI_EVENT_PORT = 9777;
+
+// Button names of the remote section of Kodi's keymap
+struct EventKey {
+  uint8_t     action;
+  const char* button;
 };
-const int kNumButtons = sizeof(kButtons) / sizeof(kButtons[0]);
-
-// ===== ISR =====
-void ICACHE_RAM_ATTR onIrEdge() {
-  unsigned long now = micros();
-  if (sLastEdgeUs != 0) {
-    unsigned long d = now - sLastEdgeUs;
-    if (d >= MIN_PULSE_US && d <= MAX_PULSE_US) {
-      int idx = sTimingIdx;
-      if (idx < SAMPLE_SIZE) {
-        sTimings[idx] = d;
-        sTimingIdx = idx + 1;
-        sCapturing = true;
-      }
-    }
-  }
-  sLastEdgeUs = now;
-}
 
-// ===== Helpers =====
-static inline bool within(unsigned long v, unsigned long ref, unsigned long tol) {
-  return (v + tol >= ref) && (v <= ref + tol);
+const EventKey kEventKeys[] = {
+  { PL_ActUp,          "up"        },
+  { PL_ActDown,        "down"      },
+  { PL_ActLeft,        "left"      },
+  { PL_ActRight,       "right"     },
+  { PL_ActSelect,      "select"    },
+  { PL_ActBack,        "back"      },
+  { PL_ActPlayPause,   "play"      },
+  { PL_ActContextMenu, "title"     },
+  { PL_ActPageUp,      "pageplus"  },
+  { PL_ActPageDown,    "pageminus" }
+};
+
+// ===== Kodi state reconcile =====
+// TCP gets notifications, so its periodic check is only a backup
+const uint32_t RECONCILE_TCP_MS   = 10000;
+const uint32_t RECONCILE_HTTP_MS  = 2000;
+
+// ===== Loop =====
+// Between passes the loop sleeps until the next timer or IR edge, and at
+// most LOOP_IDLE_MAX_MS, which bounds the latency of what is still polled
+// (the Kodi socket, the web server, serial). WIFI_MODEM_SLEEP lets the
+// radio doze while the loop sleeps, at the cost of a few ms per request.
+const uint32_t        LOOP_IDLE_MAX_MS = 20;
+const uint32_t        LOOP_FRAME_MS    = 2;     // while a NEC frame is coming in
+const WiFiSleepType_t WIFI_SLEEP       = WIFI_NONE_SLEEP;
+
+// ===== Idle power =====
+// After POWER_IDLE_AFTER_MS without a press the radio sleeps through
+// POWER_LISTEN_INTERVAL beacons and, with WIFI_LIGHT_SLEEP, the CPU stops
+// too; the first IR mark wakes it and WIFI_SLEEP is back before the press
+// is sent. The web server and serial are looked at every
+// POWER_IDLE_POLL_MS meanwhile. Waking takes a few ms of the header mark,
+// the decoder allows POWER_WAKE_LATE_US of it. 0 stays awake.
+const uint32_t        POWER_IDLE_AFTER_MS   = 60000;
+const WiFiSleepType_t POWER_IDLE_SLEEP      = WIFI_LIGHT_SLEEP;
+const uint8_t         POWER_LISTEN_INTERVAL = 3;
+const uint32_t        POWER_IDLE_POLL_MS    = 500;
+const uint16_t        POWER_WAKE_LATE_US    = 5000;
+
+// ===== Logging =====
+// Log lines go through a ring and reach Serial when the loop is idle.
+// LOG_LEVEL in build_flags strips levels at compile time (see logger.h);
+// SYSLOG_HOST also sends every line to a syslog server, "" for none.
+const char*    SYSLOG_HOST = "";
+const uint16_t SYSLOG_PORT = 514;
+
+// ===== Diagnostics =====
+// GET /stats on this port, or send 's' (print) / 'r' (reset) over serial.
+// GET /metrics has the counters in the Prometheus text format.
+const uint16_t STATS_PORT = 80;
+
+// ===== Memory telemetry =====
+// Heap and stack are sampled every MEM_SAMPLE_MS and reported with /stats.
+// Sustained fragmentation above MEM_FRAG_REINIT_PCT reconnects to Kodi, at
+// most once per MEM_REINIT_COOLDOWN_MS.
+const uint32_t MEM_SAMPLE_MS          = 1000;
+const uint8_t  MEM_FRAG_REINIT_PCT    = 50;
+const uint32_t MEM_REINIT_COOLDOWN_MS = 10UL * 60 * 1000;
+
+// ===== Startup =====
+// Boot until WiFi is up and the Kodi socket is open, i.e. the first press
+// that can go out
+static unsigned long gReadyMs = 0;
+
+// ===== Decoder state (loop side) =====
+static NecDecoder    gNec;
+static unsigned long gFrameStartUs = 0;
+static unsigned long gWokeUs       = 0;   // frame start of the burst that woke the CPU, 0 if none
+
+// ===== Targets (loop side) =====
+static uint8_t gTargetMode  = TARGET_START;   // TARGET_AUTO, TARGET_ALL or a target
+static uint8_t gLastPlaying = 0;
+
+// ===== Keymap =====
+// Read from LittleFS at boot (built with tools/mkkeymap.py), the built-in
+// Apple TV 2 map is used without it. 'p' over serial switches profile.
+const char* KEYMAP_PATH = "/keymap.bin";
+
+// ===== JSON-RPC helpers =====
+uint16_t targetPort(const KodiTarget& k) {
+  return KODI_TRANSPORT == RPC_TCP ? k.tcpPort : k.port;
 }
 
-static inline void resetCapture() {
-  sTimingIdx = 0;
-  sCapturing = false;
-  sFrameReady = false;
+// Port 0 in the settings turns a target off. The first one stays, with
+// only discovered boxes.
+bool targetUsed(uint8_t t) {
+  return t == 0 || settings().targets[t].port != 0;
 }
 
-const IRButton* lookupButton(uint8_t addr, uint8_t cmd) {
-  for (int i = 0; i < kNumButtons; i++) {
-    if (kButtons[i].addr == addr && kButtons[i].cmd == cmd) return &kButtons[i];
+void initHttp() {
+  for (uint8_t t = 0; t < KODI_TARGETS; t++) {
+    const SettingsTarget& k = settings().targets[t];
+    LOG_I("Kodi %s: %s:%u", kTargets[t].name, k.host, k.port);
+    rpcSelect(t);
+    // no host: it doesn't connect until rpcSetHost()
+    rpcBegin(KODI_TRANSPORT, k.port ? k.host : "", k.port, KODI_AUTH ? KODI_USER : nullptr, KODI_PASS,
+             HTTP_TIMEOUT_MS);
   }
-  return nullptr;
+  rpcSelect(0);
 }
 
-// Returns 0 if no valid frame, else 32 bit NEC value
-uint32_t decodeNEC() {
-  if (sTimingIdx < 34) return 0;
-  int i = 0;
-  if (!within(sTimings[i++], NEC_HDR_MARK_US,  NEC_TOLERANCE_US)) return 0;
-  if (!within(sTimings[i++], NEC_HDR_SPACE_US, NEC_TOLERANCE_US)) return 0;
+// ===== Targets =====
+// rpc and the context rules always look at the same target
+void selectTarget(uint8_t t) {
+  rpcSelect(t);
+  kodiSelect(t);
+}
 
-  uint32_t v = 0;
-  for (int bit = 0; bit < 32; bit++) {
-    if (i >= sTimingIdx - 1) return 0;
-    if (!within(sTimings[i++], NEC_BIT_MARK_US, NEC_TOLERANCE_US)) return 0;
+const char* targetModeName(uint8_t mode) {
+  if (mode == TARGET_AUTO) return "auto";
+  if (mode == TARGET_ALL)  return "all";
+  return kTargets[mode].name;
+}
 
-    if      (within(sTimings[i], NEC_ONE_SPACE_US,  NEC_TOLERANCE_US))  v |= (1UL << bit);
-    else if (within(sTimings[i], NEC_ZERO_SPACE_US, NEC_TOLERANCE_US))  { /* zero bit */ }
-    else return 0;
-    i++;
+// The only target with a player, -1 if none or several
+int8_t playingTarget() {
+  int8_t found = -1;
+  for (uint8_t t = 0; t < KODI_TARGETS; t++) {
+    if (kodiState(t).playerId < 0) continue;
+    if (found >= 0) return -1;
+    found = t;
   }
-  return v;
+  return found;
 }
 
-// ===== JSON-RPC helpers =====
-void initHttp() {
-  if (!gHttpInitialized) {
-    String url = String("http://") + KODI_HOST + ":" + KODI_PORT + "/jsonrpc";
-    gHttp.setTimeout(HTTP_TIMEOUT_MS);
-    gHttp.begin(gWifi, url);
-    gHttp.setReuse(true); 
-    
-    if (KODI_AUTH) {
-      String auth = String(KODI_USER) + ":" + String(KODI_PASS);
-      gHttp.addHeader("Authorization", "Basic " + base64::encode(auth));
-    }
-    gHttp.addHeader("Content-Type", "application/json");
-    gHttp.addHeader("Connection", "keep-alive");  
-    
-    gHttpInitialized = true;
-  }
+// Selects the target a new press is matched against; in TARGET_ALL the
+// others get it matched against their own context
+void pickTarget() {
+  if (gTargetMode < KODI_TARGETS) { selectTarget(gTargetMode); return; }
+  int8_t playing = playingTarget();
+  if (playing >= 0) gLastPlaying = playing;
+  selectTarget(gLastPlaying);
 }
 
-bool httpPostJson(const String& body, String* out = nullptr) {
-  initHttp(); 
-  
-  int code = gHttp.POST(body);
-  if (code == 200) {
-    if (out) *out = gHttp.getString();
-    return true;
+void nextTarget() {
+  if (gTargetMode == TARGET_AUTO)      gTargetMode = 0;
+  else if (gTargetMode == TARGET_ALL)  gTargetMode = TARGET_AUTO;
+  else {
+    do gTargetMode++;
+    while (gTargetMode < KODI_TARGETS && !targetUsed(gTargetMode));
+    if (gTargetMode >= KODI_TARGETS) gTargetMode = TARGET_ALL;
   }
-  
-  Serial.printf("HTTP %d for %s\n", code, body.c_str());
-  
-  gHttpInitialized = false;
-  gHttp.end();
-  return false;
-}
-
-bool actionExecute(const char* action) {
-  StaticJsonDocument<JSON_SMALL> d;
-  d["jsonrpc"] = "2.0";
-  d["method"]  = "Input.ExecuteAction";
-  d["id"]      = 1;
-  d["params"]["action"] = action;
-  String body; serializeJson(d, body);
-  return httpPostJson(body, nullptr);
-}
-
-bool guiActivate(const char* window) {
-  StaticJsonDocument<JSON_SMALL> d;
-  d["jsonrpc"] = "2.0";
-  d["method"]  = "GUI.ActivateWindow";
-  d["id"]      = 1;
-  d["params"]["window"] = window;
-  String body; serializeJson(d, body);
-  return httpPostJson(body, nullptr);
-}
-
-inline bool actPlayPause()   { return actionExecute("playpause"); }
-inline bool actOSD()         { return actionExecute("osd"); }
-inline bool actContextMenu() { return actionExecute("contextmenu"); }
-inline bool actStepFwd()     { return actionExecute("stepforward"); }
-inline bool actStepBack()    { return actionExecute("stepback"); }
-inline bool actPowerMenu()   { return guiActivate("shutdownmenu"); }
+  LOG_I("target: %s", targetModeName(gTargetMode));
+  pickTarget();
+}
+
+bool actionExecute(const RpcPayload& p) {
+  kodiStateTouch();
+  return rpcEnqueue(p);
+}
+
+void onPingReply(bool ok, uint32_t) {
+  if (ok) LOG_I("Kodi reachable");
+  else LOG_W("Kodi unreachable. Enable Control in Kodi settings.");
+}
 
 bool rpcPing() {
-  StaticJsonDocument<JSON_SMALL> d;
-  d["jsonrpc"] = "2.0";
-  d["method"]  = "JSONRPC.Ping";
-  d["id"]      = 1;
-  String body; serializeJson(d, body);
-  return httpPostJson(body, nullptr);
+  return rpcEnqueue(kRpcPing, onPingReply);
 }
 
-int getActivePlayerId() {
-  StaticJsonDocument<JSON_SMALL> d;
-  d["jsonrpc"] = "2.0";
-  d["method"]  = "Player.GetActivePlayers";
-  d["id"]      = 1;
-  String body; serializeJson(d, body);
+// ===== Behavior =====
+// Every buffer is static, so the firmware's own footprint is fixed at build time
+void printStaticRam(Print& out) {
+  out.printf("static RAM: rpc %u, web %u, keymap %u, latency %u, IR trace %u, events %u, metrics %u, log %u, settings %u bytes\n",
+             (unsigned)kRpcRamBytes, (unsigned)kWebRamBytes, (unsigned)kKeymapRamBytes,
+             (unsigned)kLatencyRamBytes, (unsigned)kIrTraceRamBytes, (unsigned)kEventRamBytes,
+             (unsigned)kMetricsRamBytes, (unsigned)kLogRamBytes, (unsigned)kSettingsRamBytes);
+}
 
-  String resp;
-  if (!httpPostJson(body, &resp)) return -1;
+void printMap() {
+  logFlush();
+  keymapPrint(Serial);
+  Serial.printf("payloads: %u bytes flash\n", (unsigned)kPayloadFlashBytes);
+  printStaticRam(Serial);
+  Serial.println("================");
+}
 
-  StaticJsonDocument<JSON_MED> r;
-  if (deserializeJson(r, resp)) return -1;
+// Page actions that stand in for a run of steps
+struct PageStep {
+  uint8_t step;
+  uint8_t page;
+};
 
-  JsonArray arr = r["result"].as<JsonArray>();
-  if (arr.isNull() || arr.size() == 0) return -1;
+const PageStep kPageSteps[] = {
+  { PL_ActUp,   PL_ActPageUp   },
+  { PL_ActDown, PL_ActPageDown }
+};
 
-  for (JsonVariant v : arr) {
-    if (strcmp(v["type"] | "", "video") == 0) return v["playerid"].as<int>();
+bool actionStep(uint8_t action, uint8_t steps) {
+  if (steps >= REPEAT_PAGE_STEPS) {
+    for (const PageStep& ps : kPageSteps) {
+      if (ps.step == action) { action = ps.page; steps = 1; break; }
+    }
   }
-  return arr[0]["playerid"].as<int>();
+  kodiStateTouch();
+  return rpcEnqueueStep(*kPayloads[action], steps);
 }
 
-bool guiIsFullscreenVideo() {
-  StaticJsonDocument<JSON_SMALL> d;
-  d["jsonrpc"] = "2.0";
-  d["method"]  = "GUI.GetProperties";
-  d["id"]      = 1;
-  JsonArray props = d["params"].createNestedArray("properties");
-  props.add("currentwindow");
+// EventServer button for action, nullptr if it only goes over JSON-RPC
+const char* eventKey(uint8_t action) {
+  for (const EventKey& k : kEventKeys) {
+    if (k.action == action) return k.button;
+  }
+  return nullptr;
+}
 
-  String body; serializeJson(d, body);
-  String resp;
-  if (!httpPostJson(body, &resp)) return false;
+// Sends the action of r to the selected target
+bool sendAction(const KeyRule& r, uint8_t steps) {
+  // Kodi repeats a held EventServer button itself
+  const char* key = KODI_EVENTS && r.context == KEY_ALWAYS ? eventKey(r.action) : nullptr;
+  if (key && (r.trigger == KEY_REPEAT ? eventHold(key) : eventPress(key))) {
+    kodiStateTouch();
+    return true;
+  }
+  // repeats coalesce in the queue instead of piling up behind a slow Kodi
+  if (r.trigger == KEY_REPEAT) return actionStep(r.action, steps);
+  if (r.context != KEY_ALWAYS) {
+    kodiStateTouch();
+    return specSend(r);
+  }
+  return actionExecute(*kPayloads[r.action]);
+}
 
-  StaticJsonDocument<JSON_MED> r;
-  if (deserializeJson(r, resp)) return false;
+// Gesture engine callback
+bool runAction(const KeyRule& r, uint8_t steps) {
+  if (r.action == KEY_ACT_PROFILE_NEXT) {
+    keymapNextProfile();
+    LOG_I("profile: %s", keymapProfileName());
+    return true;
+  }
+  if (r.action == KEY_ACT_TARGET_NEXT) {
+    nextTarget();
+    return true;
+  }
+  if (gTargetMode != TARGET_ALL) return sendAction(r, steps);
+
+  // queued on every socket now, they go out side by side
+  uint8_t primary = rpcSelected();
+  bool sent = false;
+  for (uint8_t t = 0; t < KODI_TARGETS; t++) {
+    if (!targetUsed(t)) continue;
+    selectTarget(t);
+    const KeyRule* own = t == primary ? &r : keymapMatch(r.button, (KeyTrigger)r.trigger, r.partner);
+    if (own && own->action < PL_COUNT) sent = sendAction(*own, steps) || sent;
+  }
+  selectTarget(primary);
+  return sent;
+}
 
-  const char* name = r["result"]["currentwindow"]["name"] | "";
-  int id = r["result"]["currentwindow"]["id"] | 0;
-  return (name && strcmp(name, "fullscreenvideo") == 0) || (id == 12005);
+// Gesture engine release callback
+void onRelease(uint8_t) {
+  if (KODI_EVENTS) eventRelease();
 }
 
-bool isPureFullscreenPlayback() {
-  if (getActivePlayerId() < 0) return false;
+// ===== Diagnostics =====
+void printJitter(Print& out) {
+  const NecJitter& j = gNec.jitter;
+  out.printf("=== IR jitter (%s capture, tolerance %u us) ===\n", irCaptureName(), gNec.toleranceUs);
+  out.printf("marks  %lu  mean dev %ld us\n", (unsigned long)j.marks,
+             j.marks ? (long)(j.markDevSumUs / (int32_t)j.marks) : 0L);
+  out.printf("spaces %lu  mean dev %ld us\n", (unsigned long)j.spaces,
+             j.spaces ? (long)(j.spaceDevSumUs / (int32_t)j.spaces) : 0L);
+  out.printf("max |dev| %u us\n", j.maxDevUs);
+  for (uint8_t i = 0; i < NEC_JITTER_BUCKETS; i++) {
+    unsigned lo = i * NEC_JITTER_BUCKET_US;
+    if (i + 1 < NEC_JITTER_BUCKETS) out.printf("  %3u-%3u us: %lu\n", lo, lo + NEC_JITTER_BUCKET_US - 1, (unsigned long)j.hist[i]);
+    else                           out.printf("  %3u+    us: %lu\n", lo, (unsigned long)j.hist[i]);
+  }
+}
 
-  StaticJsonDocument<JSON_SMALL> d;
-  d["jsonrpc"] = "2.0";
-  d["method"]  = "GUI.GetProperties";
-  d["id"]      = 1;
-  JsonArray props = d["params"].createNestedArray("properties");
-  props.add("currentwindow");
-  props.add("currentcontrol");
+void printTargets(Print& out) {
+  out.printf("=== Kodi targets (presses go to %s) ===\n", targetModeName(gTargetMode));
+  uint8_t current = rpcSelected();
+  for (uint8_t t = 0; t < KODI_TARGETS; t++) {
+    RpcScope at(t);
+    IPAddress ip = rpcHost();
+    out.printf("%c %-10s %u.%u.%u.%u:%u %s, %s, round trip %lu ms\n", t == current ? '*' : ' ',
+               kTargets[t].name, ip[0], ip[1], ip[2], ip[3], rpcPort(),
+               rpcConnected() ? "connected" : "not connected",
+               kodiState(t).playerId >= 0 ? "playing" : "idle", (unsigned long)rpcRttMs());
+  }
+}
 
-  String body; serializeJson(d, body);
-  String resp;
-  if (!httpPostJson(body, &resp)) return false;
+void printStartup(Print& out) {
+  wifiLinkPrint(out);
+  discoveryPrint(out);
+  if (gReadyMs) out.printf("ready %lu ms after boot\n", gReadyMs);
+  else          out.printf("not ready yet\n");
+}
 
-  StaticJsonDocument<JSON_MED> r;
-  if (deserializeJson(r, resp)) return false;
+void handleStats(Print& out, const char*) {
+  printStartup(out);
+  latencyPrint(out, keymapButtonName);
+  printTargets(out);
+  printJitter(out);
+  specPrint(out);
+  if (KODI_EVENTS) eventPrint(out);
+  memStatsPrint(out);
+  printStaticRam(out);
+  schedPrint(out);
+  powerPrint(out);
+  logPrint(out);
+  syslogPrint(out);
+}
 
-  const char* wname = r["result"]["currentwindow"]["name"] | "";
-  int wid = r["result"]["currentwindow"]["id"] | 0;
-  bool fs = (wname && strcmp(wname, "fullscreenvideo") == 0) || (wid == 12005);
-  if (!fs) return false;
+// /trace?from=N pages through the records, ?mode=... and ?clear change them
+void handleTrace(Print& out, const char* query) {
+  if (strncmp(query, "mode=", 5) == 0) {
+    for (uint8_t m = IR_TRACE_OFF; m <= IR_TRACE_ALL; m++) {
+      if (strcmp(query + 5, irTraceModeName((IrTraceMode)m)) == 0) irTraceSetMode((IrTraceMode)m);
+    }
+  } else if (strcmp(query, "clear") == 0) {
+    irTraceClear();
+  }
+  uint8_t from = strncmp(query, "from=", 5) == 0 ? atoi(query + 5) : 0;
+  irTracePrint(out, from, IR_TRACE_PAGE);
+  if (from + IR_TRACE_PAGE < irTraceCount()) out.printf("# more: /trace?from=%u\n", from + IR_TRACE_PAGE);
+}
 
-  const char* ctype  = r["result"]["currentcontrol"]["type"]  | "";
-  const char* clabel = r["result"]["currentcontrol"]["label"] | "";
-  bool hasFocus = (ctype && *ctype) || (clabel && *clabel);
-  return !hasFocus;
+const char* targetName(uint8_t t) {
+  return kTargets[t].name;
 }
 
-bool playerIsForeground() {
-  if (getActivePlayerId() < 0) return false;
-  return guiIsFullscreenVideo();
+void handleMetrics(Print& out, const char*) {
+  metricsPrint(out, KODI_TARGETS, targetName);
 }
 
-// ===== Behavior =====
-void printMap() {
-  Serial.println("=== Mappings ===");
-  for (int i = 0; i < kNumButtons; i++) {
-    Serial.printf("%-11s short: %s", kButtons[i].name, kButtons[i].shortAction ? kButtons[i].shortAction : "(none)");
-    if (kButtons[i].holdRepeat) Serial.print(" | hold: repeat");
-    if (strcmp(kButtons[i].name, "LEFT") == 0 || strcmp(kButtons[i].name, "RIGHT") == 0)
-      Serial.print(" | double click: skip");
-    if (strcmp(kButtons[i].name, "DOWN") == 0)
-      Serial.print(" | fullscreen: OSD");
-    if (strcmp(kButtons[i].name, "PLAY_PAUSE") == 0)
-      Serial.print(" | hold: power menu");
-    if (strcmp(kButtons[i].name, "SELECT") == 0)
-      Serial.print(" | hold in UI: context menu; pure fullscreen short: play/pause");
-    Serial.println();
+// ===== Live settings =====
+Settings defaultSettings() {
+  Settings s = {};
+  s.timing      = { HOLD_DELAY_MS, DOUBLECLICK_MS, REPEAT_RATE_MS, RELEASE_WINDOW_PCT,
+                    REPEAT_ACCEL_MS, REPEAT_STEPS_MAX };
+  s.toleranceUs = NEC_TOLERANCE_US;
+  for (uint8_t t = 0; t < KODI_TARGETS; t++) {
+    strlcpy(s.targets[t].host, kTargets[t].host, sizeof(s.targets[t].host));
+    s.targets[t].port = targetPort(kTargets[t]);
   }
-  Serial.println("================");
+  strlcpy(s.wifiSsid, WIFI_SSID, sizeof(s.wifiSsid));
+  strlcpy(s.wifiPass, WIFI_PASS, sizeof(s.wifiPass));
+  return s;
 }
 
-void handleShortPress(const IRButton* b) {
-  if (!b || !b->shortAction) return;
-
-  if (strcmp(b->name, "PLAY_PAUSE") == 0) return;
-  if (strcmp(b->name, "SELECT") == 0)     return;
+// No button held or waiting for its multi-tap window, no frame half decoded
+bool betweenPresses() {
+  return gestureIdle() && !necBusy(gNec);
+}
 
-  if (strcmp(b->name, "DOWN") == 0) {
-    if (playerIsForeground()) { actOSD(); return; }
+// Swaps in staged settings and keymap. Only between presses: nothing holds
+// a button index of the old keymap or is halfway through a frame.
+void commitConfig() {
+  if (!betweenPresses()) return;
+  keymapCommit();
+  const Settings* was = settingsCommit();
+  if (!was) return;
+
+  const Settings& s = settings();
+  gestureSetTiming(s.timing);
+  gNec.toleranceUs = s.toleranceUs;
+  for (uint8_t t = 0; t < KODI_TARGETS; t++) {
+    const SettingsTarget& k = s.targets[t];
+    // unchanged ones keep whatever discovery failed over to
+    if (strcmp(k.host, was->targets[t].host) == 0 && k.port == was->targets[t].port) continue;
+    LOG_I("Kodi %s: %s:%u", kTargets[t].name, k.host, k.port);
+    // the first one's candidates and saved host belong to discovery
+    if (t == 0) { discoverySetHost(k.port ? k.host : "", k.port); continue; }
+    IPAddress ip;
+    if (k.port && !ip.fromString(k.host)) continue;
+    RpcScope at(t);
+    rpcSetHost(ip, k.port);   // port 0: unset, stops connecting
   }
+  // presses don't stay pointed at a target that was turned off
+  if (gTargetMode < KODI_TARGETS && !targetUsed(gTargetMode)) gTargetMode = TARGET_AUTO;
+  if (!targetUsed(gLastPlaying)) gLastPlaying = 0;
+  pickTarget();
+}
 
-  if (strcmp(b->name, "RIGHT") == 0 || strcmp(b->name, "LEFT") == 0) {
-    unsigned long now = millis();
-    bool isRight = strcmp(b->name, "RIGHT") == 0;
-    bool dbl = false;
-    if (getActivePlayerId() >= 0) {
-      if (isRight) { dbl = (now - gLastRightMs) <= DOUBLECLICK_MS; gLastRightMs = now; }
-      else         { dbl = (now - gLastLeftMs)  <= DOUBLECLICK_MS; gLastLeftMs  = now; }
-      if (dbl) { if (isRight) actStepFwd(); else actStepBack(); return; }
-    }
+// A keymap on LittleFS: "/name.bin", no directories, nothing to escape
+// the filesystem root with
+bool keymapPathOk(const char* path) {
+  size_t n = strlen(path);
+  if (n < 5 || n > 31 || path[0] != '/' || strcmp(path + n - 4, ".bin") != 0) return false;
+  for (const char* p = path + 1; *p; p++) {
+    if (!isalnum((unsigned char)*p) && *p != '_' && *p != '-' && *p != '.') return false;
   }
-
-  actionExecute(b->shortAction);
+  return strstr(path, "..") == nullptr;
 }
 
-void handleHoldRepeat() {
-  if (!gPressedName) return;
-
-  if (strcmp(gPressedName, "PLAY_PAUSE") == 0) return;
-  if (strcmp(gPressedName, "SELECT") == 0)     return;
+const char* stageKeymap(const char* path) {
+  if (!*path) path = KEYMAP_PATH;
+  return keymapPathOk(path) ? keymapStage(path) : "bad path";
+}
 
-  const IRButton* b = nullptr;
-  for (int i = 0; i < kNumButtons; i++) {
-    if (strcmp(kButtons[i].name, gPressedName) == 0) { b = &kButtons[i]; break; }
+void handleConfig(Print& out, const char* query) {
+  char key[16];
+  // one more than any setting takes, so an over-long value fails instead of being cut
+  char value[SETTINGS_PASS_LEN + 1];
+  while (webParam(query, key, sizeof(key), value, sizeof(value))) {
+    const char* err = nullptr;
+    if (strcmp(key, "keymap") == 0)     err = stageKeymap(value);
+    else if (strcmp(key, "reset") == 0) settingsReset();
+    else                                err = settingsSet(key, value);
+    if (err) out.printf("# %s: %s\n", key, err);
   }
-  if (!b || !b->holdRepeat) return;
+  commitConfig();
+  settingsPrint(out);
+}
 
-  if (millis() - gLastRepeatMs >= REPEAT_RATE_MS) {
-    actionExecute(b->shortAction);
-    gLastRepeatMs = millis();
-  }
+void nextTraceMode() {
+  irTraceSetMode((IrTraceMode)((irTraceMode() + 1) % (IR_TRACE_ALL + 1)));
+  LOG_I("IR trace: %s", irTraceModeName(irTraceMode()));
 }
 
-void handleRelease() {
-  if (gPressedName && strcmp(gPressedName, "PLAY_PAUSE") == 0) {
-    if (!gHoldActive && !gPlayPauseHoldDone) actPlayPause();
+void onFragmented(uint8_t fragPct) {
+  LOG_W("heap fragmentation %u%%, reconnecting to Kodi", fragPct);
+  for (uint8_t t = 0; t < KODI_TARGETS; t++) {
+    RpcScope at(t);
+    rpcReconnect();
   }
+}
 
-  if (gPressedName && strcmp(gPressedName, "SELECT") == 0) {
-    if (!gHoldActive && !gSelectHoldDone) {
-      if (isPureFullscreenPlayback()) actPlayPause();
-      else actionExecute("select");
-    }
+void pollSerial() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    logFlush();
+    if (c == 's') { printStartup(Serial); latencyPrint(Serial, keymapButtonName); printTargets(Serial); printJitter(Serial); memStatsPrint(Serial); schedPrint(Serial); powerPrint(Serial); logPrint(Serial); }
+    else if (c == 'p') { keymapNextProfile(); printMap(); }
+    else if (c == 'n') { nextTarget(); }
+    else if (c == 'c') { settingsPrint(Serial); }
+    else if (c == 't') { irTracePrint(Serial); }
+    else if (c == 'T') { nextTraceMode(); }
+    else if (c == 'r') { latencyReset(); necJitterReset(gNec); memStatsReset(); schedReset(); irTraceClear(); Serial.println("stats reset"); }
   }
-
-  gPressedName = nullptr;
-  gHoldActive = false;
-  gPlayPauseHoldDone = false;
-  gSelectHoldDone    = false;
 }
 
 // ===== Arduino lifecycle =====
@@ -378,83 +604,134 @@ void setup() {
   Serial.begin(115200);
   Serial.println();
   Serial.println("Apple TV 2 IR -> Kodi JSON-RPC");
-  Serial.printf("WiFi SSID: %s  Kodi: %s:%d\n", WIFI_SSID, KODI_HOST, KODI_PORT);
-
-  WiFi.mode(WIFI_STA);
-  WiFi.setSleepMode(WIFI_NONE_SLEEP);
-  WiFi.begin(WIFI_SSID, WIFI_PASS);
-  while (WiFi.status() != WL_CONNECTED) { delay(300); Serial.print("."); }
-  Serial.printf("\nWiFi connected, IP %s\n", WiFi.localIP().toString().c_str());
-
-  pinMode(IR_PIN, INPUT_PULLUP);
-  attachInterrupt(digitalPinToInterrupt(IR_PIN), onIrEdge, CHANGE);
-
-  Serial.println("Testing JSONRPC.Ping");
-  if (rpcPing()) Serial.println("Kodi reachable");
-  else Serial.println("Kodi unreachable. Enable Control in Kodi settings.");
-
+  settingsBegin(defaultSettings());
+  const Settings& cfg = settings();
+  Serial.printf("WiFi SSID: %s\n", cfg.wifiSsid);
+
+  // IR decodes from here on, WiFi joins in the background
+  keymapBegin(KEYMAP_PATH);
+  gestureBegin(cfg.timing, runAction);
+  gestureSetReleaseHandler(onRelease);
+  necInit(gNec, cfg.toleranceUs);
+  irCaptureBegin(IR_CAPTURE, IR_PIN, MIN_PULSE_US, MAX_PULSE_US);
+  irTraceSetMode(IR_TRACE_MODE);
+  syslogBegin(SYSLOG_HOST, SYSLOG_PORT, MDNS_HOSTNAME);
+
+  powerBegin({ POWER_IDLE_AFTER_MS, WIFI_SLEEP, POWER_IDLE_SLEEP, POWER_LISTEN_INTERVAL });
+  wifiLinkBegin({ cfg.wifiSsid, cfg.wifiPass, WIFI_IP, WIFI_GATEWAY, WIFI_SUBNET, WIFI_DNS,
+                  WIFI_FAST_TIMEOUT_MS, WIFI_FULL_TIMEOUT_MS });
+
+  initHttp();
+  const char* service = KODI_TRANSPORT == RPC_TCP ? "xbmc-jsonrpc" : "xbmc-jsonrpc-h";
+  discoveryBegin(0, MDNS_HOSTNAME, KODI_DISCOVER ? service : nullptr,
+                 cfg.targets[0].port ? cfg.targets[0].host : "",
+                 cfg.targets[0].port, KODI_FAILOVER_AFTER);
+  rpcSetNotifyHandler(kodiOnNotification);
+  rpcSetConnectGate(betweenPresses);
+  discoverySetSaveGate(betweenPresses);
+  kodiStateBegin(KODI_TARGETS, KODI_TRANSPORT == RPC_TCP ? RECONCILE_TCP_MS : RECONCILE_HTTP_MS);
+  pickTarget();
+  specBegin(kSpecUndo, sizeof(kSpecUndo) / sizeof(kSpecUndo[0]));
+  if (KODI_EVENTS) eventBegin(KODI_EVENT_PORT, MDNS_HOSTNAME);
+  otaBegin(MDNS_HOSTNAME, OTA_PASSWORD, OTA_PORT);
+
+  webBegin(STATS_PORT);
+  webOn("/stats", handleStats);
+  webOn("/trace", handleTrace);
+  webOn("/metrics", handleMetrics);
+  webOn("/config", handleConfig);
+  memStatsBegin(MEM_SAMPLE_MS, MEM_FRAG_REINIT_PCT, MEM_REINIT_COOLDOWN_MS, onFragmented);
+
+  schedReset();
   printMap();
 }
 
-void loop() {
-  if (sCapturing && (micros() - sLastEdgeUs) > IDLE_TIMEOUT_US) {
-    sCapturing = false;
-    sFrameReady = true;
-  }
+// ===== IR frames =====
+void handleFrame(uint32_t v, unsigned long frameReadyUs) {
+  unsigned long decodedUs = micros();
+  uint8_t addr = (v >> 16) & 0xFF;
+  uint8_t cmd  = (v >> 8)  & 0xFF;
+
+  uint8_t id = keymapLookup(v);
+  metricsPress(id);
+  // unknown codes stay in release builds, they are how a new remote gets mapped
+  if (id != KEY_NONE) LOG_D("IR A=0x%02X C=0x%02X -> %s", addr, cmd, keymapButtonName(id));
+  else                LOG_I("IR A=0x%02X C=0x%02X -> UNKNOWN", addr, cmd);
+
+  LatToken trace = id != KEY_NONE ? latencyBegin(id, gFrameStartUs, frameReadyUs, decodedUs) : 0;
+  if (gWokeUs) latencyWoke(trace, gWokeUs);
+  pickTarget();
+  gestureFrame(id, gFrameStartUs, trace);
+}
 
-  if (sFrameReady && sTimingIdx > 0) {
-    uint32_t v = decodeNEC();
-    if (v != 0) {
-      uint8_t addr = (v >> 16) & 0xFF;
-      uint8_t cmd  = (v >> 8)  & 0xFF;
-
-      const IRButton* b = lookupButton(addr, cmd);
-      Serial.printf("IR A=0x%02X C=0x%02X -> %s\n", addr, cmd, b ? b->name : "UNKNOWN");
-
-      if (b) {
-        handleShortPress(b);
-        gPressedName   = b->name;
-        gPressStartMs  = millis();
-        gLastRepeatMs  = gPressStartMs;
-        gHoldActive    = false;
-        gPlayPauseHoldDone = false;
-        gSelectHoldDone    = false;
-      } else {
-        handleRelease();
-      }
-    }
-    resetCapture();
-  }
+// Every decoder result goes to the trace and the counters
+NecEvent recordResult(NecEvent ev) {
+  irTraceResult(ev, gNec);
+  metricsNec(ev, gNec.reject);
+  return ev;
+}
 
-  if (gPressedName && !gHoldActive) {
-    if ((millis() - gPressStartMs) >= HOLD_DELAY_MS) {
-      gHoldActive = true;
-      gLastRepeatMs = millis();
-      Serial.printf("%s HOLD start\n", gPressedName);
-
-      if (strcmp(gPressedName, "PLAY_PAUSE") == 0) {
-        actPowerMenu();            
-        gPlayPauseHoldDone = true;
-      } else if (strcmp(gPressedName, "SELECT") == 0) {
-        if (!playerIsForeground()) {
-          actContextMenu();       
-          gSelectHoldDone = true;
-        }
+void pollIr() {
+  if (irCaptureOverflowed()) { LOG_W("IR ring overflow"); irTraceOverflow(); gMetrics.overflows++; }
+  irCapturePoll();
+
+  uint16_t d;
+  while (irCapturePop(d)) {
+    if (d == IR_FRAME_MARK) {
+      recordResult(necGap(gNec));
+      gMetrics.bursts++;
+      gFrameStartUs = irCaptureFrameStartUs();
+      irTraceStart(gFrameStartUs);
+      powerWake();
+      gWokeUs = 0;
+      if (irCaptureWoke()) {
+        necLateStart(gNec, POWER_WAKE_LATE_US);
+        gWokeUs = gFrameStartUs;
       }
+      continue;
     }
+    unsigned long readyUs = micros();
+    irTraceEdge(d);
+    NecEvent ev = recordResult(necFeed(gNec, d));
+    if (ev == NEC_FRAME)       handleFrame(gNec.value, readyUs);
+    else if (ev == NEC_REPEAT) gestureRepeat(gFrameStartUs);
   }
 
-  // Hold repeat
-  if (gHoldActive) handleHoldRepeat();
+  // a frame that stopped mid-way gets no closing marker until the next one starts
+  if (necBusy(gNec) && irCaptureIdleUs() > IDLE_TIMEOUT_US) recordResult(necGap(gNec));
+}
 
-  // Release inferred by inactivit
-  if (gPressedName) {
-    unsigned long sinceEdgeMs = (micros() - sLastEdgeUs) / 1000UL;
-    if (sinceEdgeMs > RELEASE_TIMEOUT_MS) {
-      if (gHoldActive) Serial.printf("%s RELEASE\n", gPressedName);
-      handleRelease();
-    }
-  }
+void pollReady() {
+  if (gReadyMs || !wifiLinkUp() || !rpcConnected()) return;
+  gReadyMs = millis();
+  LOG_I("ready %lu ms after boot, testing JSONRPC.Ping", gReadyMs);
+  rpcPing();
+}
 
-  delay(5);
+// How long the loop may sleep before something polled needs a look
+uint32_t loopSleepCap() {
+  if (rpcPendingAll() > 0) return 0;             // a reply may be arriving
+  if (necBusy(gNec))    return LOOP_FRAME_MS;    // the idle timeout closes the frame
+  if (powerIdle())      return POWER_IDLE_POLL_MS; // IR edges still wake it at once
+  return LOOP_IDLE_MAX_MS;
+}
+
+void loop() {
+  wifiLinkPoll();
+  discoveryPoll();
+  pollReady();
+  rpcPoll();
+  pollIr();
+
+  timerPoll();
+  rpcPoll();
+  webPoll();
+  pollSerial();
+  memStatsPoll();
+  powerPoll();
+  otaPoll();
+  commitConfig();
+  // the UART only gets bytes while no frame is coming in
+  if (!necBusy(gNec)) logPoll();
+  schedSleep(loopSleepCap());
 }
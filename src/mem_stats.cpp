@@ -0,0 +1,80 @@
+#include "mem_stats.h"
+
+// ===== Reinit =====
+const uint8_t MEM_FRAG_SAMPLES = 3;   // consecutive samples over the limit
+
+static MemStats      gMem;
+static uint32_t      gSampleMs   = 1000;
+static uint8_t       gFragLimit  = 0;
+static uint32_t      gCooldownMs = 0;
+static MemReinitFn   gReinit     = nullptr;
+static unsigned long gNextSampleMs = 0;
+static unsigned long gLastReinitMs = 0;
+static bool          gReinitDone   = false;
+static uint8_t       gOverLimit    = 0;
+
+static void sample() {
+  uint32_t heap  = ESP.getFreeHeap();
+  uint16_t block = ESP.getMaxFreeBlockSize();
+  uint8_t  frag  = ESP.getHeapFragmentation();
+  uint32_t stack = ESP.getFreeContStack();
+
+  bool first = gMem.samples++ == 0;
+  gMem.heapFree = heap;
+  gMem.maxBlock = block;
+  gMem.frag     = frag;
+  if (first || heap  < gMem.heapFreeMin)  gMem.heapFreeMin  = heap;
+  if (first || heap  > gMem.heapFreeMax)  gMem.heapFreeMax  = heap;
+  if (first || block < gMem.maxBlockMin)  gMem.maxBlockMin  = block;
+  if (first || frag  > gMem.fragMax)      gMem.fragMax      = frag;
+  if (first || stack < gMem.stackFreeMin) gMem.stackFreeMin = stack;
+}
+
+static void checkFragmentation() {
+  if (!gFragLimit || !gReinit) return;
+  gOverLimit = gMem.frag > gFragLimit ? gOverLimit + 1 : 0;
+  if (gOverLimit < MEM_FRAG_SAMPLES) return;
+  if (gReinitDone && millis() - gLastReinitMs < gCooldownMs) return;
+
+  gOverLimit    = 0;
+  gReinitDone   = true;
+  gLastReinitMs = millis();
+  gMem.reinits++;
+  gReinit(gMem.frag);
+}
+
+void memStatsBegin(uint32_t sampleMs, uint8_t fragLimitPct, uint32_t cooldownMs, MemReinitFn fn) {
+  gSampleMs   = sampleMs;
+  gFragLimit  = fragLimitPct;
+  gCooldownMs = cooldownMs;
+  gReinit     = fn;
+  memStatsReset();
+}
+
+void memStatsPoll() {
+  if ((long)(millis() - gNextSampleMs) < 0) return;
+  gNextSampleMs = millis() + gSampleMs;
+  sample();
+  checkFragmentation();
+}
+
+const MemStats& memStats() {
+  return gMem;
+}
+
+void memStatsPrint(Print& out) {
+  out.printf("=== Memory (%lu samples) ===\n", (unsigned long)gMem.samples);
+  out.printf("free heap  %lu  min %lu  max %lu\n", (unsigned long)gMem.heapFree,
+             (unsigned long)gMem.heapFreeMin, (unsigned long)gMem.heapFreeMax);
+  out.printf("max block  %u  min %u\n", gMem.maxBlock, gMem.maxBlockMin);
+  out.printf("frag       %u%%  max %u%%\n", gMem.frag, gMem.fragMax);
+  out.printf("loop stack %lu bytes never used\n", (unsigned long)gMem.stackFreeMin);
+  out.printf("reinits    %u\n", gMem.reinits);
+}
+
+void memStatsReset() {
+  memset(&gMem, 0, sizeof(gMem));
+  gOverLimit    = 0;
+  gNextSampleMs = millis() + gSampleMs;
+  sample();
+}
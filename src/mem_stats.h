@@ -0,0 +1,36 @@
+/*
+  Heap and stack telemetry
+
+  The firmware runs for weeks, so slow heap fragmentation matters more
+  than a single allocation. memStatsPoll() samples free heap, the largest
+  free block, the fragmentation percentage and the loop stack high-water
+  mark every sampleMs and keeps min/max since the last reset.
+
+  If fragmentation stays above fragLimitPct for a few samples in a row the
+  reinit callback runs (at most once per cooldown), so the caller can tear
+  down and rebuild whatever holds long-lived allocations, e.g. the Kodi
+  connection, before requests start failing.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+struct MemStats {
+  uint32_t samples;
+  uint32_t heapFree,  heapFreeMin,  heapFreeMax;
+  uint16_t maxBlock,  maxBlockMin;
+  uint8_t  frag,      fragMax;        // %
+  uint32_t stackFreeMin;              // untouched loop stack, bytes
+  uint16_t reinits;
+};
+
+typedef void (*MemReinitFn)(uint8_t fragPct);
+
+// fragLimitPct 0 disables the reinit
+void memStatsBegin(uint32_t sampleMs, uint8_t fragLimitPct, uint32_t cooldownMs, MemReinitFn fn);
+void memStatsPoll();
+
+const MemStats& memStats();
+void memStatsPrint(Print& out);
+void memStatsReset();
@@ -0,0 +1,80 @@
+#include "metrics.h"
+
+Metrics gMetrics;
+
+const size_t kMetricsRamBytes = sizeof(gMetrics);
+
+// ===== Text format =====
+static void family(Print& out, const char* name, const char* type) {
+  out.printf("# TYPE %s %s\n", name, type);
+}
+
+static void counter(Print& out, const char* name, uint32_t v) {
+  family(out, name, "counter");
+  out.printf("%s %lu\n", name, (unsigned long)v);
+}
+
+static void labelled(Print& out, const char* name, const char* label, const char* lv, uint32_t v) {
+  out.printf("%s{%s=\"%s\"} %lu\n", name, label, lv, (unsigned long)v);
+}
+
+// ===== Per target =====
+typedef uint32_t (*RpcValueFn)(const RpcMetrics& m);
+
+static uint8_t       gTargets = 0;
+static MetricsNameFn gTargetName = nullptr;
+
+static void perTarget(Print& out, const char* name, const char* type, RpcValueFn get) {
+  family(out, name, type);
+  for (uint8_t t = 0; t < gTargets; t++) labelled(out, name, "target", gTargetName(t), get(gMetrics.rpc[t]));
+}
+
+static void httpResponses(Print& out) {
+  static const char* const kClasses[METRICS_HTTP_CLASSES] = { "other", "1xx", "2xx", "3xx", "4xx", "5xx" };
+  family(out, "rpc_http_responses_total", "counter");
+  for (uint8_t t = 0; t < gTargets; t++) {
+    for (uint8_t c = 0; c < METRICS_HTTP_CLASSES; c++) {
+      uint32_t n = gMetrics.rpc[t].http[c];
+      if (n) out.printf("rpc_http_responses_total{target=\"%s\",status=\"%s\"} %lu\n", gTargetName(t),
+                        kClasses[c], (unsigned long)n);
+    }
+  }
+}
+
+// ===== Public =====
+void metricsPrint(Print& out, uint8_t targets, MetricsNameFn targetName) {
+  gTargets    = targets < RPC_TARGETS_MAX ? targets : RPC_TARGETS_MAX;
+  gTargetName = targetName;
+
+  family(out, "uptime_seconds", "gauge");
+  out.printf("uptime_seconds %lu\n", (unsigned long)(millis() / 1000));
+
+  counter(out, "ir_bursts_total", gMetrics.bursts);
+  counter(out, "ir_frames_total", gMetrics.frames);
+  counter(out, "ir_repeats_total", gMetrics.repeats);
+  counter(out, "ir_overflows_total", gMetrics.overflows);
+  family(out, "ir_rejects_total", "counter");
+  for (uint8_t r = NEC_REJECT_HDR_MARK; r < METRICS_REJECTS; r++)
+    labelled(out, "ir_rejects_total", "reason", necRejectName((NecReject)r), gMetrics.rejects[r]);
+
+  family(out, "presses_total", "counter");
+  for (uint8_t b = 0; b < keymapButtons(); b++)
+    labelled(out, "presses_total", "button", keymapButtonName(b), gMetrics.presses[b]);
+
+  // only what was sent, most of the table never is
+  family(out, "rpc_calls_total", "counter");
+  for (uint8_t p = 0; p < PL_COUNT; p++) {
+    if (gMetrics.calls[p]) labelled(out, "rpc_calls_total", "method", kPayloads[p]->label, gMetrics.calls[p]);
+  }
+
+  perTarget(out, "rpc_replies_total", "counter", [](const RpcMetrics& m) { return m.replies; });
+  httpResponses(out);
+  perTarget(out, "rpc_errors_total", "counter", [](const RpcMetrics& m) { return m.errors; });
+  perTarget(out, "rpc_timeouts_total", "counter", [](const RpcMetrics& m) { return m.timeouts; });
+  perTarget(out, "rpc_stale_total", "counter", [](const RpcMetrics& m) { return m.stale; });
+  perTarget(out, "rpc_queue_full_total", "counter", [](const RpcMetrics& m) { return m.queueFull; });
+  perTarget(out, "rpc_connects_total", "counter", [](const RpcMetrics& m) { return m.connects; });
+  perTarget(out, "rpc_connect_failures_total", "counter", [](const RpcMetrics& m) { return m.connectFails; });
+  perTarget(out, "rpc_reconnects_total", "counter", [](const RpcMetrics& m) { return m.reconnects; });
+  perTarget(out, "rpc_queue_depth_max", "gauge", [](const RpcMetrics& m) { return (uint32_t)m.queueMax; });
+}
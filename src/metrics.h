@@ -0,0 +1,73 @@
+/*
+  Runtime counters
+
+  Always on: everything that happens on the way from IR edge to Kodi
+  reply bumps a plain uint32_t in one static struct, so counting costs a
+  load, an add and a store and never allocates. Nothing is reset except
+  by a reboot, which is what scrapers expect from counters.
+
+  metricsPrint() renders them in the Prometheus text format, for GET
+  /metrics. The page is rendered into the web server's buffer in one go
+  and sent as the socket takes it; IR edges keep going into the capture
+  ring meanwhile, so a scrape never costs a press.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "keymap.h"
+#include "nec_decoder.h"
+#include "payloads.h"
+#include "rpc.h"
+
+const uint8_t METRICS_REJECTS      = NEC_REJECT_TRUNCATED + 1;
+const uint8_t METRICS_HTTP_CLASSES = 6;    // by hundreds, 0: no status line
+
+// Kept per rpc target
+struct RpcMetrics {
+  uint32_t replies;                          // answered calls
+  uint32_t http[METRICS_HTTP_CLASSES];
+  uint32_t errors;                           // answered with a JSON-RPC error
+  uint32_t timeouts;
+  uint32_t stale;                            // dropped before going out
+  uint32_t queueFull;
+  uint32_t connects;
+  uint32_t connectFails;
+  uint32_t reconnects;                       // dropped on purpose (host change, heap)
+  uint8_t  queueMax;                         // queue depth high-water mark
+};
+
+struct Metrics {
+  uint32_t   bursts;                         // IR bursts seen
+  uint32_t   frames;                         // decoded
+  uint32_t   repeats;
+  uint32_t   rejects[METRICS_REJECTS];       // by NecReject
+  uint32_t   overflows;                      // capture ring
+  uint32_t   presses[KEYMAP_BUTTONS_MAX];    // frames per keymap button
+  uint32_t   calls[PL_COUNT];                // payloads sent, batch parts each
+  RpcMetrics rpc[RPC_TARGETS_MAX];
+};
+
+extern Metrics gMetrics;
+
+// One decoder result
+inline void metricsNec(NecEvent ev, NecReject reject) {
+  if (ev == NEC_FRAME)       gMetrics.frames++;
+  else if (ev == NEC_REPEAT) gMetrics.repeats++;
+  else if (ev == NEC_REJECT) gMetrics.rejects[reject < METRICS_REJECTS ? reject : NEC_REJECT_NONE]++;
+}
+
+inline void metricsPress(uint8_t button) {
+  if (button < KEYMAP_BUTTONS_MAX) gMetrics.presses[button]++;
+}
+
+inline RpcMetrics& metricsRpc(uint8_t target) {
+  return gMetrics.rpc[target];
+}
+
+// Series for the first targets rpc targets, labelled by targetName(i)
+typedef const char* (*MetricsNameFn)(uint8_t target);
+void metricsPrint(Print& out, uint8_t targets, MetricsNameFn targetName);
+
+extern const size_t kMetricsRamBytes;
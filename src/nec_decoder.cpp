@@ -0,0 +1,113 @@
+#include "nec_decoder.h"
+
+static inline bool within(uint16_t v, uint16_t ref, uint16_t tol) {
+  return (uint32_t)v + tol >= ref && v <= (uint32_t)ref + tol;
+}
+
+// Records the deviation and passes the verdict through
+static bool accept(NecDecoder& d, uint16_t us, uint16_t ref, bool mark) {
+  if (!within(us, ref, d.toleranceUs)) return false;
+  NecJitter& j = d.jitter;
+  int32_t dev = (int32_t)us - ref;
+  uint16_t mag = dev < 0 ? -dev : dev;
+  if (mark) { j.marks++;  j.markDevSumUs  += dev; }
+  else      { j.spaces++; j.spaceDevSumUs += dev; }
+  if (mag > j.maxDevUs) j.maxDevUs = mag;
+  uint16_t b = mag / NEC_JITTER_BUCKET_US;
+  j.hist[b < NEC_JITTER_BUCKETS ? b : NEC_JITTER_BUCKETS - 1]++;
+  return true;
+}
+
+static NecEvent rejectFrame(NecDecoder& d, NecReject why) {
+  d.state  = NEC_SKIP;
+  d.reject = why;
+  return NEC_REJECT;
+}
+
+void necInit(NecDecoder& d, uint16_t toleranceUs) {
+  d.state       = NEC_WAIT_HDR_MARK;
+  d.bit         = 0;
+  d.value       = 0;
+  d.toleranceUs = toleranceUs;
+  d.lateUs      = 0;
+  d.reject      = NEC_REJECT_NONE;
+  necJitterReset(d);
+}
+
+void necJitterReset(NecDecoder& d) {
+  d.jitter = NecJitter();
+}
+
+NecEvent necFeed(NecDecoder& d, uint16_t us) {
+  switch (d.state) {
+    case NEC_WAIT_HDR_MARK: {
+      uint16_t late = d.lateUs;
+      d.lateUs = 0;
+      if (late && us < NEC_HDR_MARK_US && (uint32_t)us + late + d.toleranceUs >= NEC_HDR_MARK_US) {
+        d.state = NEC_WAIT_HDR_SPACE;
+        return NEC_NONE;
+      }
+      if (!accept(d, us, NEC_HDR_MARK_US, true)) return rejectFrame(d, NEC_REJECT_HDR_MARK);
+      d.state = NEC_WAIT_HDR_SPACE;
+      return NEC_NONE;
+    }
+
+    case NEC_WAIT_HDR_SPACE:
+      if (accept(d, us, NEC_REPEAT_SPACE_US, false)) { d.state = NEC_WAIT_REPEAT_MARK; return NEC_NONE; }
+      if (!accept(d, us, NEC_HDR_SPACE_US, false)) return rejectFrame(d, NEC_REJECT_HDR_SPACE);
+      d.bit   = 0;
+      d.value = 0;
+      d.state = NEC_WAIT_BIT_MARK;
+      return NEC_NONE;
+
+    case NEC_WAIT_BIT_MARK:
+      if (!accept(d, us, NEC_BIT_MARK_US, true)) return rejectFrame(d, NEC_REJECT_BIT_MARK);
+      d.state = NEC_WAIT_BIT_SPACE;
+      return NEC_NONE;
+
+    case NEC_WAIT_BIT_SPACE:
+      if      (accept(d, us, NEC_ONE_SPACE_US,  false)) d.value |= (1UL << d.bit);
+      else if (!accept(d, us, NEC_ZERO_SPACE_US, false)) return rejectFrame(d, NEC_REJECT_BIT_SPACE);
+      if (++d.bit < 32) { d.state = NEC_WAIT_BIT_MARK; return NEC_NONE; }
+      // the stop mark that follows carries no information
+      d.state  = NEC_SKIP;
+      d.reject = NEC_REJECT_NONE;
+      return NEC_FRAME;
+
+    case NEC_WAIT_REPEAT_MARK:
+      if (!accept(d, us, NEC_BIT_MARK_US, true)) return rejectFrame(d, NEC_REJECT_REPEAT_MARK);
+      d.state  = NEC_SKIP;
+      d.reject = NEC_REJECT_NONE;
+      return NEC_REPEAT;
+
+    case NEC_SKIP:
+      return NEC_NONE;
+  }
+  return NEC_NONE;
+}
+
+NecEvent necGap(NecDecoder& d) {
+  bool busy = necBusy(d);
+  d.state  = NEC_WAIT_HDR_MARK;
+  d.lateUs = 0;
+  if (!busy) return NEC_NONE;
+  d.reject = NEC_REJECT_TRUNCATED;
+  return NEC_REJECT;
+}
+
+void necLateStart(NecDecoder& d, uint16_t lateUs) {
+  if (d.state == NEC_WAIT_HDR_MARK) d.lateUs = lateUs;
+}
+
+const char* necRejectName(NecReject r) {
+  switch (r) {
+    case NEC_REJECT_NONE:         return "ok";
+    case NEC_REJECT_HDR_MARK:     return "header mark";
+    case NEC_REJECT_HDR_SPACE:    return "header space";
+    case NEC_REJECT_BIT_MARK:     return "bit mark";
+    case NEC_REJECT_BIT_SPACE:    return "bit space";
+    case NEC_REJECT_REPEAT_MARK:  return "repeat mark";
+    case NEC_REJECT_TRUNCATED:    return "truncated";
+  }
+  return "?";
+}
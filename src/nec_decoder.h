@@ -0,0 +1,102 @@
+/*
+  Streaming NEC decoder
+
+  Fed one mark/space duration at a time as they come out of the capture
+  ring. It walks header mark, header space, then 32 x (bit mark, bit
+  space) and reports the frame the moment the 32nd bit's space validates,
+  without waiting for the stop mark or for the line to go idle. A duration
+  that doesn't fit rejects the frame right there; the rest of it is
+  skipped until the next gap.
+
+  While a key is held the remote sends a short repeat burst instead of the
+  full frame (header mark, 2.25 ms space, one mark), about every 108 ms.
+  It carries no key code and is reported as NEC_REPEAT.
+
+  No Arduino dependencies, so it can be built and replayed on the host.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// ===== NEC timing (microseconds) =====
+#define NEC_HDR_MARK_US    9000
+#define NEC_HDR_SPACE_US   4500
+#define NEC_BIT_MARK_US     560
+#define NEC_ONE_SPACE_US   1690
+#define NEC_ZERO_SPACE_US   560
+#define NEC_REPEAT_SPACE_US 2250
+#define NEC_REPEAT_PERIOD_US 108000  // frame start to frame start while held
+
+enum NecEvent : uint8_t {
+  NEC_NONE,      // need more durations
+  NEC_FRAME,     // value holds a complete 32 bit frame
+  NEC_REPEAT,    // repeat burst, the last key is still held
+  NEC_REJECT     // frame abandoned, reject says why
+};
+
+enum NecReject : uint8_t {
+  NEC_REJECT_NONE,
+  NEC_REJECT_HDR_MARK,
+  NEC_REJECT_HDR_SPACE,
+  NEC_REJECT_BIT_MARK,
+  NEC_REJECT_BIT_SPACE,
+  NEC_REJECT_REPEAT_MARK,
+  NEC_REJECT_TRUNCATED   // gap before all 32 bits arrived
+};
+
+enum NecState : uint8_t {
+  NEC_WAIT_HDR_MARK,
+  NEC_WAIT_HDR_SPACE,
+  NEC_WAIT_BIT_MARK,
+  NEC_WAIT_BIT_SPACE,
+  NEC_WAIT_REPEAT_MARK,
+  NEC_SKIP               // frame handled or rejected, ignore until the next gap
+};
+
+// Deviation of every accepted duration from its nominal length. The bias
+// shows the receiver stretching marks and shrinking spaces, the histogram
+// and max how much of the tolerance the jitter actually uses.
+const uint8_t  NEC_JITTER_BUCKETS  = 8;
+const uint16_t NEC_JITTER_BUCKET_US = 32;   // last bucket is open ended
+
+struct NecJitter {
+  uint32_t marks;
+  uint32_t spaces;
+  int32_t  markDevSumUs;     // signed
+  int32_t  spaceDevSumUs;
+  uint16_t maxDevUs;
+  uint32_t hist[NEC_JITTER_BUCKETS];
+};
+
+struct NecDecoder {
+  NecState  state;
+  uint8_t   bit;
+  uint32_t  value;
+  uint16_t  toleranceUs;
+  uint16_t  lateUs;      // the next header mark may be this much short
+  NecReject reject;
+  NecJitter jitter;
+};
+
+void     necInit(NecDecoder& d, uint16_t toleranceUs);
+
+// One mark or space duration
+NecEvent necFeed(NecDecoder& d, uint16_t us);
+
+// The line was idle long enough to end a frame
+NecEvent necGap(NecDecoder& d);
+
+// After necGap(): the burst's first edge was stamped up to lateUs late
+// (woken from light sleep), so its header mark may come out that short.
+// Such a header doesn't count towards the jitter stats.
+void necLateStart(NecDecoder& d, uint16_t lateUs);
+
+// True while a frame is partially received
+inline bool necBusy(const NecDecoder& d) {
+  return d.state != NEC_WAIT_HDR_MARK && d.state != NEC_SKIP;
+}
+
+void necJitterReset(NecDecoder& d);
+
+const char* necRejectName(NecReject r);
@@ -0,0 +1,35 @@
+#include "ota.h"
+
+#include <ArduinoOTA.h>
+
+#include "logger.h"
+#include "wifi_link.h"
+
+static bool gStarted = false;
+
+static void onStart() {
+  LOG_I("OTA update starting");
+  logFlush();
+}
+
+static void onError(ota_error_t err) {
+  LOG_W("OTA update failed (%u)", (unsigned)err);
+}
+
+void otaBegin(const char* hostname, const char* password, uint16_t port) {
+  ArduinoOTA.setHostname(hostname);
+  ArduinoOTA.setPort(port);
+  if (password && *password) ArduinoOTA.setPassword(password);
+  ArduinoOTA.onStart(onStart);
+  ArduinoOTA.onError(onError);
+}
+
+void otaPoll() {
+  if (!gStarted) {
+    if (!wifiLinkUp()) return;
+    // discovery runs the mDNS responder
+    ArduinoOTA.begin(false);
+    gStarted = true;
+  }
+  ArduinoOTA.handle();
+}
@@ -0,0 +1,17 @@
+/*
+  Firmware updates over WiFi
+
+  ArduinoOTA listens once WiFi is up (pio run -e ota -t upload, or the
+  Arduino IDE's network port). An upload takes over loop() until it is
+  done and the board restarts into the new firmware; nothing else is
+  touched until it starts. The mDNS responder started for discovery
+  answers for the hostname, so uploads can go to <hostname>.local.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+// password "" accepts any upload. hostname must stay valid.
+void otaBegin(const char* hostname, const char* password, uint16_t port);
+void otaPoll();
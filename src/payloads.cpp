@@ -0,0 +1,16 @@
+#include "payloads.h"
+
+#define KODI_PAYLOAD_DEF(name, label, body)                                          \
+  static const char kJson##name[] PROGMEM = body;                                    \
+  static_assert(sizeof(kJson##name) - 1 <= RPC_BODY_MAX, "payload " #name " too big"); \
+  const RpcPayload kRpc##name = { kJson##name, sizeof(kJson##name) - 1, label, PL_##name };
+KODI_PAYLOADS(KODI_PAYLOAD_DEF)
+#undef KODI_PAYLOAD_DEF
+
+#define KODI_PAYLOAD_PTR(name, label, body) &kRpc##name,
+const RpcPayload* const kPayloads[PL_COUNT] = { KODI_PAYLOADS(KODI_PAYLOAD_PTR) };
+#undef KODI_PAYLOAD_PTR
+
+#define KODI_PAYLOAD_SIZE(name, label, body) + sizeof(body)
+const size_t kPayloadFlashBytes = 0 KODI_PAYLOADS(KODI_PAYLOAD_SIZE);
+#undef KODI_PAYLOAD_SIZE
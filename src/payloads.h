@@ -0,0 +1,68 @@
+/*
+  Pre-serialized JSON-RPC payloads
+
+  Every request this firmware sends is fixed, so the bodies are spelled out
+  here once and the compiler concatenates them into PROGMEM strings. The hot
+  path only hands a pointer to the send queue; nothing is built, serialized
+  or allocated per press. Each payload is its own kJson* symbol, so its flash
+  cost shows up in the map file, and payloads.cpp checks the sizes at build
+  time.
+*/
+
+#pragma once
+
+#include "rpc.h"
+
+// ===== Body builders =====
+// The body stops after "id": so the transport can append a per-call id.
+#define KODI_CALL(method, params) \
+  "{\"jsonrpc\":\"2.0\",\"method\":\"" method "\"," params "\"id\":"
+
+#define KODI_ACTION(action) \
+  KODI_CALL("Input.ExecuteAction", "\"params\":{\"action\":\"" action "\"},")
+
+#define KODI_WINDOW(window) \
+  KODI_CALL("GUI.ActivateWindow", "\"params\":{\"window\":\"" window "\"},")
+
+// ===== Payload table =====
+// X(name, label, body)
+#define KODI_PAYLOADS(X)                                                                        \
+  X(ActBack,        "back",         KODI_ACTION("back"))                                        \
+  X(ActPlayPause,   "playpause",    KODI_ACTION("playpause"))                                   \
+  X(ActUp,          "up",           KODI_ACTION("up"))                                          \
+  X(ActDown,        "down",         KODI_ACTION("down"))                                        \
+  X(ActLeft,        "left",         KODI_ACTION("left"))                                        \
+  X(ActRight,       "right",        KODI_ACTION("right"))                                       \
+  X(ActSelect,      "select",       KODI_ACTION("select"))                                      \
+  X(ActOSD,         "osd",          KODI_ACTION("osd"))                                         \
+  X(ActContextMenu, "contextmenu",  KODI_ACTION("contextmenu"))                                 \
+  X(ActStepFwd,     "stepforward",  KODI_ACTION("stepforward"))                                 \
+  X(ActStepBack,    "stepback",     KODI_ACTION("stepback"))                                    \
+  X(WinPowerMenu,   "shutdownmenu", KODI_WINDOW("shutdownmenu"))                                \
+  X(Ping,           "ping",         KODI_CALL("JSONRPC.Ping", ""))                              \
+  X(GetPlayers,     "players",      KODI_CALL("Player.GetActivePlayers", ""))                   \
+  X(GetWindow,      "window",       KODI_CALL("GUI.GetProperties",                              \
+                                      "\"params\":{\"properties\":[\"currentwindow\"]},"))      \
+  X(GetWindowFocus, "window+focus", KODI_CALL("GUI.GetProperties",                              \
+                                      "\"params\":{\"properties\":[\"currentwindow\",\"currentcontrol\"]},"))  \
+  X(ActPageUp,      "pageup",       KODI_ACTION("pageup"))                                      \
+  X(ActPageDown,    "pagedown",     KODI_ACTION("pagedown"))
+
+#define KODI_PAYLOAD_DECL(name, label, body) extern const RpcPayload kRpc##name;
+KODI_PAYLOADS(KODI_PAYLOAD_DECL)
+#undef KODI_PAYLOAD_DECL
+
+// ===== Payload ids =====
+// Position in KODI_PAYLOADS. Keymap files refer to actions by id, so new
+// payloads go at the end of the table.
+enum PayloadId : uint8_t {
+#define KODI_PAYLOAD_ID(name, label, body) PL_##name,
+  KODI_PAYLOADS(KODI_PAYLOAD_ID)
+#undef KODI_PAYLOAD_ID
+  PL_COUNT
+};
+
+extern const RpcPayload* const kPayloads[PL_COUNT];
+
+// Total flash used by all payload bodies, including terminators
+extern const size_t kPayloadFlashBytes;
@@ -0,0 +1,59 @@
+#include "power.h"
+
+#include "ir_capture.h"
+#include "logger.h"
+
+static PowerConfig   gCfg;
+static bool          gIdle        = false;
+static unsigned long gLastBurstMs = 0;
+
+// ===== Stats =====
+static uint32_t      gWakes       = 0;
+static unsigned long gIdleSinceMs = 0;
+static uint64_t      gIdleMs      = 0;   // finished idle periods
+
+static void setIdle(bool idle) {
+  gIdle = idle;
+  WiFi.setSleepMode(idle ? gCfg.idleSleep : gCfg.activeSleep, idle ? gCfg.listenInterval : 0);
+  if (idle) {
+    gIdleSinceMs = millis();
+  } else {
+    gIdleMs += millis() - gIdleSinceMs;
+  }
+}
+
+void powerBegin(const PowerConfig& cfg) {
+  gCfg         = cfg;
+  gLastBurstMs = millis();
+  WiFi.setSleepMode(cfg.activeSleep);
+}
+
+void powerPoll() {
+  if (gIdle || !gCfg.idleAfterMs || millis() - gLastBurstMs < gCfg.idleAfterMs) return;
+  // a press in progress: try again after it
+  if (!irCaptureArmWake()) { gLastBurstMs = millis(); return; }
+  LOG_D("idle, %s", gCfg.idleSleep == WIFI_LIGHT_SLEEP ? "light sleep" : "modem sleep");
+  setIdle(true);
+}
+
+bool powerWake() {
+  gLastBurstMs = millis();
+  if (!gIdle) return false;
+  irCaptureDisarmWake();   // in case the burst came in without a wake
+  setIdle(false);
+  gWakes++;
+  return true;
+}
+
+bool powerIdle() {
+  return gIdle;
+}
+
+void powerPrint(Print& out) {
+  if (!gCfg.idleAfterMs) return;
+  uint64_t idleMs = gIdleMs + (gIdle ? millis() - gIdleSinceMs : 0);
+  out.printf("=== Power ===\n");
+  out.printf("%s, idle after %lu s, %lu wakes, idle %lu%% of the time\n", gIdle ? "idle" : "active",
+             (unsigned long)(gCfg.idleAfterMs / 1000), (unsigned long)gWakes,
+             millis() ? (unsigned long)(idleMs * 100 / millis()) : 0UL);
+}
@@ -0,0 +1,40 @@
+/*
+  Idle power mode
+
+  Presses come a few hundred times a day; in between the board has
+  nothing to do but keep the Kodi connection open. After idleAfterMs
+  without an IR burst powerPoll() switches the WiFi sleep type to
+  idleSleep (light sleep: the CPU stops between beacons as well as the
+  radio) and arms the IR pin to wake it. The station stays associated
+  and sockets stay open in both sleep types, so nothing has to reconnect
+  when a press comes.
+
+  The first mark of a press wakes the CPU; pollIr() calls powerWake(),
+  which goes back to activeSleep at once so the request and its reply go
+  out without waiting for a beacon. Light sleep wakes in a few ms, well
+  within the 9 ms header mark: the decoder gets told the mark came out
+  short (necLateStart()) and the press is decoded as usual.
+*/
+
+#pragma once
+
+#include <ESP8266WiFi.h>
+
+struct PowerConfig {
+  uint32_t        idleAfterMs;      // 0: never idle
+  WiFiSleepType_t activeSleep;
+  WiFiSleepType_t idleSleep;
+  uint8_t         listenInterval;   // beacons the radio may sleep through while idle
+};
+
+void powerBegin(const PowerConfig& cfg);
+
+// Enters the idle mode once it has been quiet for long enough
+void powerPoll();
+
+// An IR burst started. True if it came while idle, which it ends.
+bool powerWake();
+
+bool powerIdle();
+
+void powerPrint(Print& out);
@@ -0,0 +1,660 @@
+#include "rpc.h"
+
+#include <ESP8266WiFi.h>
+#include <WiFiClient.h>
+
+#include "latency.h"
+#include "logger.h"
+#include "metrics.h"
+
+// ===== Transport limits =====
+const size_t   RPC_TX_MAX         = 1024; // fits a full batch of steps
+const size_t   RPC_LINE_MAX       = 96;
+const size_t   RPC_READ_BUDGET    = 256;  // bytes consumed per rpcPoll() pass and target
+const uint32_t RPC_BACKOFF_MIN_MS = 250;
+const uint32_t RPC_BACKOFF_MAX_MS = 5000;
+const uint32_t RPC_STALE_MS       = 1000; // queued calls older than this are dropped
+const uint8_t  RPC_TIMEOUTS_MAX   = 2;    // consecutive TCP timeouts before reconnecting
+// WiFiClient::connect() waits for the handshake, which takes a few ms on
+// a LAN; a box that doesn't answer costs this much of loop()
+const uint32_t RPC_CONNECT_TIMEOUT_MS = 100;
+
+// ===== Queue =====
+struct RpcCall {
+  const RpcPayload* body;
+  RpcReplyFn        onReply;
+  uint32_t          arg;
+  unsigned long     queuedMs;
+  LatToken          trace;
+  const RpcPayload* const* parts;  // rpcEnqueueBatch(): the bodies, else nullptr
+  uint8_t           count;     // > 1: sent as a batch (of parts, or copies of body)
+  bool              step;      // from rpcEnqueueStep()
+};
+
+// ===== In-flight calls =====
+// Written but not answered yet. HTTP has at most one; the TCP transport
+// pipelines up to RPC_INFLIGHT_MAX and matches replies by their id.
+struct RpcInflight {
+  RpcCall       call;
+  uint32_t      id;
+  unsigned long sentMs;
+  bool          used;
+};
+
+// ===== HTTP response parser =====
+enum HttpRx : uint8_t {
+  HTTP_RX_STATUS,
+  HTTP_RX_HEADERS,
+  HTTP_RX_BODY,
+  // Transfer-Encoding: chunked
+  HTTP_RX_CHUNK_SIZE,
+  HTTP_RX_CHUNK_DATA,
+  HTTP_RX_TRAILER,
+  HTTP_RX_DONE
+};
+
+// ===== Message scanner =====
+// Replies and notifications are scanned as they arrive, never buffered.
+// The scanner finds where each message ends (TCP sends them back to back)
+// and picks up the top level "id" so replies can be matched, and an
+// "error" member so a refused call counts as failed; every event is passed
+// on to the rpcSetMessageHandler() consumer. For a batch reply (an array)
+// the id is that of the first element and any part's error fails it.
+struct MsgState {
+  bool     idSeen;
+  uint32_t id;
+  bool     error;
+  int32_t  code;
+};
+
+// ===== Targets =====
+// Everything one Kodi needs: its own socket, queue, request buffer and
+// parsers, so a slow or unreachable box never holds up another one
+struct RpcLink {
+  uint8_t      index;           // target
+
+  // queue
+  RpcCall      calls[RPC_QUEUE_LEN];
+  uint8_t      head;
+  uint8_t      count;
+
+  // in flight
+  RpcInflight  inflight[RPC_INFLIGHT_MAX];
+  uint8_t      inflightCount;
+  uint32_t     nextId;
+  uint8_t      timeoutsInRow;
+  uint8_t      failStreak;      // failed connects and timeouts since the last reply
+  uint32_t     rttMs;
+
+  // connection
+  WiFiClient   wifi;
+  IPAddress    hostIp;
+  uint16_t     port;
+  const char*  user;
+  const char*  pass;
+  uint32_t     timeoutMs;
+  RpcTransport transport;
+  bool         begun;
+
+  // background reconnect
+  unsigned long nextConnectMs;
+  uint32_t      backoffMs;
+
+  // For HTTP tx starts with the request head rendered once by rpcBegin(),
+  // up to and including "Content-Length: ". Each call only appends length
+  // and body. TCP requests carry no framing, so there the prefix is empty.
+  char         tx[RPC_TX_MAX];
+  uint16_t     tplLen;
+  uint16_t     txLen;
+  uint16_t     txOff;
+  LatToken     txTrace;
+
+  // HTTP response
+  uint32_t     bodyLen;         // body bytes read
+  HttpRx       httpRx;
+  int          status;
+  bool         keepAlive;
+  int32_t      contentLen;
+  bool         chunked;
+  uint32_t     chunkLeft;
+  char         line[RPC_LINE_MAX];
+  uint8_t      lineLen;
+
+  JsonSax      sax;
+  MsgState     msg;
+};
+
+static RpcLink     gLinks[RPC_TARGETS_MAX];
+static uint8_t     gSelected = 0;
+static uint8_t     gNumLinks = 0;   // up to the highest target rpcBegin() set up
+
+// shared by all targets, called with the target selected
+static RpcNotifyFn gNotify = nullptr;
+static RpcGateFn   gGate   = nullptr;
+static JsonSaxFn   gMsgFn  = nullptr;
+static void*       gMsgCtx = nullptr;
+
+const size_t kRpcRamBytes = sizeof(gLinks);
+
+static RpcLink& sel() {
+  return gLinks[gSelected];
+}
+
+static RpcMetrics& stats(const RpcLink& k) {
+  return metricsRpc(k.index);
+}
+
+// ===== Queue helpers =====
+static bool queuePut(RpcLink& k, const RpcPayload& body, RpcReplyFn onReply, uint32_t arg,
+                     uint8_t count = 1, bool step = false) {
+  if (k.count >= RPC_QUEUE_LEN) {
+    LOG_W("RPC queue full, dropped %s", body.label);
+    stats(k).queueFull++;
+    return false;
+  }
+
+  RpcCall& c = k.calls[(k.head + k.count) % RPC_QUEUE_LEN];
+  k.count++;
+  c.body     = &body;
+  c.onReply  = onReply;
+  c.arg      = arg;
+  c.queuedMs = millis();
+  c.trace    = latencyActive();
+  c.parts    = nullptr;
+  c.count    = count;
+  c.step     = step;
+  latencyQueued(c.trace);
+  if (k.count > stats(k).queueMax) stats(k).queueMax = k.count;
+  return true;
+}
+
+static RpcCall queuePop(RpcLink& k) {
+  RpcCall c = k.calls[k.head];
+  k.head = (k.head + 1) % RPC_QUEUE_LEN;
+  k.count--;
+  return c;
+}
+
+// ===== Completion =====
+static void complete(const RpcCall& c, bool ok) {
+  latencyReplied(c.trace, ok);
+  if (c.onReply) c.onReply(ok, c.arg);
+}
+
+static void finishInflight(RpcLink& k, RpcInflight& f, bool ok) {
+  if (ok) {
+    uint32_t rtt = millis() - f.sentMs;
+    k.rttMs = k.rttMs ? (k.rttMs * 7 + rtt) / 8 : rtt;
+  }
+  RpcCall c = f.call;
+  f.used = false;
+  k.inflightCount--;
+  // free the slot first so follow-ups queued by the callback can go out
+  complete(c, ok);
+}
+
+static void failAllInflight(RpcLink& k) {
+  for (uint8_t i = 0; i < RPC_INFLIGHT_MAX; i++) {
+    if (k.inflight[i].used) finishInflight(k, k.inflight[i], false);
+  }
+}
+
+static void expireStale(RpcLink& k) {
+  unsigned long now = millis();
+
+  for (uint8_t i = 0; i < RPC_INFLIGHT_MAX; i++) {
+    RpcInflight& f = k.inflight[i];
+    if (!f.used || now - f.sentMs <= k.timeoutMs) continue;
+    LOG_W("RPC timeout for %s", f.call.body->label);
+    stats(k).timeouts++;
+    if (k.failStreak < 0xFF) k.failStreak++;
+    // an HTTP reply can't be resynchronised; TCP ignores late replies by id
+    if (k.transport == RPC_HTTP || ++k.timeoutsInRow >= RPC_TIMEOUTS_MAX) k.wifi.stop();
+    finishInflight(k, f, false);
+  }
+
+  while (k.count > 0 && now - k.calls[k.head].queuedMs > RPC_STALE_MS) {
+    RpcCall c = queuePop(k);
+    LOG_W("RPC stale, dropped %s", c.body->label);
+    stats(k).stale++;
+    complete(c, false);
+  }
+}
+
+static void deliver(RpcLink& k, uint32_t id, bool ok) {
+  k.timeoutsInRow = 0;
+  k.failStreak    = 0;
+
+  for (uint8_t i = 0; i < RPC_INFLIGHT_MAX; i++) {
+    RpcInflight& f = k.inflight[i];
+    if (!f.used || f.id != id) continue;
+    stats(k).replies++;
+    if (!ok) {
+      LOG_W("HTTP %d for %s", k.status, f.call.body->label);
+    } else if (k.msg.error) {
+      LOG_W("RPC error %d for %s", (int)k.msg.code, f.call.body->label);
+      stats(k).errors++;
+      ok = false;
+    }
+    finishInflight(k, f, ok);
+    return;
+  }
+  // no match: a late reply to a call that already timed out
+}
+
+static void onSax(JsonSax& s, JsonEvent ev, void* ctx) {
+  MsgState& msg = ((RpcLink*)ctx)->msg;
+  if (ev == JSON_BEGIN) msg = MsgState();
+  bool topId = jsonSaxPath(s, "id") || jsonSaxPath(s, "#.id");
+  if (ev == JSON_VALUE && topId && !msg.idSeen && !s.isString) {
+    msg.id     = jsonSaxInt(s);
+    msg.idSeen = true;
+  }
+  // an object, so it shows as JSON_END; "error": null is not an error
+  if (ev == JSON_END && (jsonSaxPath(s, "error") || jsonSaxPath(s, "#.error"))) msg.error = true;
+  if (ev == JSON_VALUE && !s.isString && !msg.code &&
+      (jsonSaxPath(s, "error.code") || jsonSaxPath(s, "#.error.code"))) {
+    msg.code = jsonSaxInt(s);
+  }
+  if (gMsgFn) gMsgFn(s, ev, gMsgCtx);
+}
+
+// ===== Connection =====
+static void resetRx(RpcLink& k) {
+  k.httpRx     = HTTP_RX_STATUS;
+  k.status     = 0;
+  k.keepAlive  = true;
+  k.contentLen = -1;
+  k.chunked    = false;
+  k.chunkLeft  = 0;
+  k.lineLen    = 0;
+  k.bodyLen    = 0;
+  k.msg        = MsgState();
+  jsonSaxReset(k.sax);
+}
+
+// Blocks for the handshake, up to RPC_CONNECT_TIMEOUT_MS: the ESP8266
+// WiFiClient has no non-blocking connect
+static bool tryConnect(RpcLink& k) {
+  k.wifi.stop();
+  resetRx(k);
+  k.txLen = k.txOff = 0;
+
+  k.wifi.setTimeout(RPC_CONNECT_TIMEOUT_MS);
+  bool ok = k.wifi.connect(k.hostIp, k.port);
+  k.wifi.setTimeout(k.timeoutMs);
+  if (ok) k.backoffMs = RPC_BACKOFF_MIN_MS;
+  // also rate limits reconnects when Kodi closes idle connections
+  k.nextConnectMs = millis() + k.backoffMs;
+  if (ok) { stats(k).connects++; return true; }
+  stats(k).connectFails++;
+  if (k.failStreak < 0xFF) k.failStreak++;
+  k.backoffMs = k.backoffMs * 2 < RPC_BACKOFF_MAX_MS ? k.backoffMs * 2 : RPC_BACKOFF_MAX_MS;
+  return false;
+}
+
+// ===== Writing =====
+static const RpcPayload& callPart(const RpcCall& c, uint8_t i) {
+  return c.parts ? *c.parts[i] : *c.body;
+}
+
+// count > 1 renders a batch: [part id},part id+1},...] with rising ids
+static bool buildRequest(RpcLink& k, const RpcCall& c, uint32_t id) {
+  // payloads end with "id": so the transport only appends the number
+  uint8_t count = c.count;
+  size_t bodyLen = count > 1 ? count + 1 : 0;   // brackets and commas
+  for (uint8_t i = 0; i < count; i++)
+    bodyLen += callPart(c, i).len + snprintf(nullptr, 0, "%lu}", (unsigned long)(id + i));
+
+  char* p = k.tx + k.tplLen;
+  if (k.transport == RPC_HTTP) p += sprintf(p, "%u\r\n\r\n", (unsigned)bodyLen);
+  // +1: sprintf writes a terminator after the last tail
+  if ((size_t)(p - k.tx) + bodyLen + 1 > sizeof(k.tx)) return false;
+  if (count > 1) *p++ = '[';
+  for (uint8_t i = 0; i < count; i++) {
+    const RpcPayload& b = callPart(c, i);
+    if (i > 0) *p++ = ',';
+    memcpy_P(p, b.json, b.len);
+    p += b.len;
+    p += sprintf(p, "%lu}", (unsigned long)(id + i));
+  }
+  if (count > 1) *p++ = ']';
+  k.txLen = p - k.tx;
+  k.txOff = 0;
+  return true;
+}
+
+static bool stepInflight(const RpcLink& k) {
+  for (uint8_t i = 0; i < RPC_INFLIGHT_MAX; i++) {
+    if (k.inflight[i].used && k.inflight[i].call.step) return true;
+  }
+  return false;
+}
+
+// Never waits: what the socket can't take now goes out on a later pass
+static void pumpWrite(RpcLink& k) {
+  if (k.txOff >= k.txLen) return;
+  size_t room = k.wifi.availableForWrite();
+  size_t left = k.txLen - k.txOff;
+  size_t n = room < left ? room : left;
+  if (n > 0) k.txOff += k.wifi.write((const uint8_t*)k.tx + k.txOff, n);
+  if (k.txOff >= k.txLen) latencyWritten(k.txTrace);
+}
+
+static void startNext(RpcLink& k) {
+  if (k.count == 0 || k.txOff < k.txLen) return;
+  uint8_t limit = k.transport == RPC_HTTP ? 1 : RPC_INFLIGHT_MAX;
+  if (k.inflightCount >= limit) return;
+  // later steps merge into this one while the previous is unanswered
+  if (k.calls[k.head].step && stepInflight(k)) return;
+
+  RpcCall c = queuePop(k);
+  uint32_t id = k.nextId;
+  k.nextId += c.count;
+  if (!buildRequest(k, c, id)) { complete(c, false); return; }
+  k.txTrace = c.trace;
+  for (uint8_t i = 0; i < c.count; i++) gMetrics.calls[callPart(c, i).id]++;
+
+  for (uint8_t i = 0; i < RPC_INFLIGHT_MAX; i++) {
+    RpcInflight& f = k.inflight[i];
+    if (f.used) continue;
+    f.call   = c;
+    f.id     = id;
+    f.sentMs = millis();
+    f.used   = true;
+    break;
+  }
+  k.inflightCount++;
+  if (k.transport == RPC_HTTP) resetRx(k);
+  pumpWrite(k);
+}
+
+// ===== Reading: HTTP =====
+static void httpLine(RpcLink& k) {
+  k.line[k.lineLen] = '\0';
+  if (k.lineLen > 0 && k.line[k.lineLen - 1] == '\r') k.line[--k.lineLen] = '\0';
+
+  if (k.httpRx == HTTP_RX_STATUS) {
+    const char* sp = strchr(k.line, ' ');
+    k.status = sp ? atoi(sp + 1) : 0;
+    k.httpRx = HTTP_RX_HEADERS;
+  } else if (k.httpRx == HTTP_RX_CHUNK_SIZE) {
+    // the empty line is the CRLF that ends the previous chunk's data
+    if (k.lineLen > 0) {
+      k.chunkLeft = strtoul(k.line, nullptr, 16);   // stops at any ";ext"
+      k.httpRx    = k.chunkLeft ? HTTP_RX_CHUNK_DATA : HTTP_RX_TRAILER;
+    }
+  } else if (k.httpRx == HTTP_RX_TRAILER) {
+    if (k.lineLen == 0) k.httpRx = HTTP_RX_DONE;
+  } else if (k.lineLen == 0) {
+    // chunked wins over any Content-Length
+    k.httpRx = k.chunked ? HTTP_RX_CHUNK_SIZE : HTTP_RX_BODY;
+  } else if (strncasecmp(k.line, "Transfer-Encoding:", 18) == 0) {
+    if (strstr(k.line + 18, "chunked")) k.chunked = true;
+  } else if (strncasecmp(k.line, "Content-Length:", 15) == 0) {
+    k.contentLen = atol(k.line + 15);
+  } else if (strncasecmp(k.line, "Connection:", 11) == 0) {
+    const char* v = k.line + 11;
+    while (*v == ' ') v++;
+    if (strncasecmp(v, "close", 5) == 0) k.keepAlive = false;
+  }
+  k.lineLen = 0;
+}
+
+static void httpRead(RpcLink& k) {
+  size_t budget = RPC_READ_BUDGET;
+  while (budget > 0 && k.wifi.available() > 0) {
+    if (k.httpRx == HTTP_RX_BODY && k.contentLen >= 0 && k.bodyLen >= (uint32_t)k.contentLen) break;
+    if (k.httpRx == HTTP_RX_DONE) break;
+    int ch = k.wifi.read();
+    if (ch < 0) break;
+    budget--;
+
+    if (k.httpRx == HTTP_RX_BODY || k.httpRx == HTTP_RX_CHUNK_DATA) {
+      jsonSaxFeed(k.sax, (char)ch);
+      k.bodyLen++;
+      if (k.httpRx == HTTP_RX_CHUNK_DATA && --k.chunkLeft == 0) k.httpRx = HTTP_RX_CHUNK_SIZE;
+    } else if (ch == '\n') {
+      httpLine(k);
+    } else if (k.lineLen < RPC_LINE_MAX - 1) {
+      k.line[k.lineLen++] = (char)ch;
+    }
+  }
+
+  if (k.inflightCount == 0) return;
+  bool done;
+  if (k.chunked)                     done = k.httpRx == HTTP_RX_DONE;
+  else if (k.httpRx != HTTP_RX_BODY) return;
+  else if (k.contentLen >= 0)        done = k.bodyLen >= (uint32_t)k.contentLen;
+  else                               done = !k.wifi.connected() && k.wifi.available() == 0;
+  if (!done) return;
+
+  if (k.contentLen < 0) k.keepAlive = false;
+  bool keepAlive = k.keepAlive;
+  uint8_t statusClass = k.status / 100;
+  stats(k).http[statusClass < METRICS_HTTP_CLASSES ? statusClass : 0]++;
+  for (uint8_t i = 0; i < RPC_INFLIGHT_MAX; i++) {
+    if (k.inflight[i].used) { deliver(k, k.inflight[i].id, k.status == 200); break; }
+  }
+  resetRx(k);
+  if (!keepAlive) k.wifi.stop();
+}
+
+// ===== Reading: TCP =====
+static void tcpRead(RpcLink& k) {
+  size_t budget = RPC_READ_BUDGET;
+  while (budget > 0 && k.wifi.available() > 0) {
+    int ch = k.wifi.read();
+    if (ch < 0) break;
+    budget--;
+
+    if (!jsonSaxFeed(k.sax, (char)ch)) continue;
+    if (k.msg.idSeen) deliver(k, k.msg.id, true);
+    else if (gNotify) gNotify();
+  }
+}
+
+// ===== Auth =====
+// Appends base64 of in to out, returns the length written
+static size_t base64Put(char* out, const char* in, size_t n) {
+  static const char kAlphabet[] PROGMEM =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char* p = out;
+  for (size_t i = 0; i < n; i += 3) {
+    uint32_t v = (uint8_t)in[i] << 16;
+    if (i + 1 < n) v |= (uint8_t)in[i + 1] << 8;
+    if (i + 2 < n) v |= (uint8_t)in[i + 2];
+    *p++ = pgm_read_byte(&kAlphabet[(v >> 18) & 63]);
+    *p++ = pgm_read_byte(&kAlphabet[(v >> 12) & 63]);
+    *p++ = i + 1 < n ? pgm_read_byte(&kAlphabet[(v >> 6) & 63]) : '=';
+    *p++ = i + 2 < n ? pgm_read_byte(&kAlphabet[v & 63]) : '=';
+  }
+  return p - out;
+}
+
+// Renders the HTTP request head for the link's host into its tx buffer
+static void renderHead(RpcLink& k) {
+  k.tplLen = 0;
+  if (k.transport != RPC_HTTP) return;
+
+  int n = snprintf(k.tx, sizeof(k.tx),
+                   "POST /jsonrpc HTTP/1.1\r\n"
+                   "Host: %u.%u.%u.%u:%u\r\n",
+                   k.hostIp[0], k.hostIp[1], k.hostIp[2], k.hostIp[3], k.port);
+  if (k.user) {
+    // user:pass goes through the line buffer, nothing is allocated
+    int credLen = snprintf(k.line, sizeof(k.line), "%s:%s", k.user, k.pass);
+    if (credLen >= (int)sizeof(k.line)) credLen = sizeof(k.line) - 1;
+    n += snprintf(k.tx + n, sizeof(k.tx) - n, "Authorization: Basic ");
+    if ((size_t)n + (credLen + 2) / 3 * 4 + 2 < sizeof(k.tx)) n += base64Put(k.tx + n, k.line, credLen);
+    n += snprintf(k.tx + n, sizeof(k.tx) - n, "\r\n");
+    memset(k.line, 0, sizeof(k.line));
+  }
+  n += snprintf(k.tx + n, sizeof(k.tx) - n,
+                "Content-Type: application/json\r\n"
+                "Connection: keep-alive\r\n"
+                "Content-Length: ");
+  k.tplLen = n;
+}
+
+static void pollLink(RpcLink& k) {
+  if (!k.wifi.connected() && k.wifi.available() == 0) {
+    if (k.inflightCount > 0) failAllInflight(k);
+    // keep the socket open in the background so presses never pay for a
+    // handshake; with nothing queued, only when no press is under way
+    bool wanted = k.count > 0 || !gGate || gGate();
+    if (wanted && WiFi.status() == WL_CONNECTED && k.hostIp.isSet() &&
+        (long)(millis() - k.nextConnectMs) >= 0)
+      tryConnect(k);
+    expireStale(k);
+    return;
+  }
+
+  pumpWrite(k);
+  if (k.transport == RPC_HTTP) httpRead(k);
+  else tcpRead(k);
+  expireStale(k);
+  startNext(k);
+}
+
+// ===== Public API =====
+void rpcSelect(uint8_t target) {
+  if (target < RPC_TARGETS_MAX) gSelected = target;
+}
+
+uint8_t rpcSelected() {
+  return gSelected;
+}
+
+uint8_t rpcTargets() {
+  return gNumLinks;
+}
+
+void rpcBegin(RpcTransport transport, const char* host, uint16_t port,
+              const char* user, const char* pass, uint32_t timeoutMs) {
+  RpcLink& k = sel();
+  k.transport = transport;
+  if (!k.hostIp.fromString(host)) k.hostIp = IPAddress();
+  jsonSaxBegin(k.sax, onSax, &k);
+  k.port      = port;
+  k.user      = user;
+  k.pass      = pass;
+  k.timeoutMs = timeoutMs;
+  k.nextId    = 1;
+  k.backoffMs = RPC_BACKOFF_MIN_MS;
+  k.begun     = true;
+  k.index     = gSelected;
+  renderHead(k);
+  if (gNumLinks <= gSelected) gNumLinks = gSelected + 1;
+
+  k.wifi.setTimeout(timeoutMs);
+  k.wifi.setNoDelay(true);
+  k.nextConnectMs = millis();
+}
+
+bool rpcEnqueue(const RpcPayload& body, RpcReplyFn onReply, uint32_t arg) {
+  return queuePut(sel(), body, onReply, arg);
+}
+
+bool rpcEnqueueBatch(const RpcPayload* const* parts, uint8_t count,
+                     RpcReplyFn onReply, uint32_t arg) {
+  RpcLink& k = sel();
+  if (count == 0 || count > RPC_BATCH_MAX) return false;
+  if (!queuePut(k, *parts[0], onReply, arg, count)) return false;
+  k.calls[(k.head + k.count - 1) % RPC_QUEUE_LEN].parts = parts;
+  return true;
+}
+
+bool rpcEnqueueStep(const RpcPayload& body, uint8_t count) {
+  RpcLink& k = sel();
+  if (count > RPC_BATCH_MAX) count = RPC_BATCH_MAX;
+  if (k.count > 0) {
+    RpcCall& tail = k.calls[(k.head + k.count - 1) % RPC_QUEUE_LEN];
+    if (tail.step && tail.body == &body) {
+      // full: drop rather than let steps pile up behind a slow Kodi
+      if (tail.count + count > RPC_BATCH_MAX) return false;
+      tail.count += count;
+      return true;
+    }
+  }
+  return queuePut(k, body, nullptr, 0, count, true);
+}
+
+void rpcSetNotifyHandler(RpcNotifyFn fn) {
+  gNotify = fn;
+}
+
+void rpcSetConnectGate(RpcGateFn fn) {
+  gGate = fn;
+}
+
+void rpcSetMessageHandler(JsonSaxFn fn, void* ctx) {
+  gMsgFn  = fn;
+  gMsgCtx = ctx;
+}
+
+size_t rpcQueued() {
+  return sel().count;
+}
+
+size_t rpcPending() {
+  return sel().count + sel().inflightCount;
+}
+
+size_t rpcPendingAll() {
+  size_t n = 0;
+  for (uint8_t t = 0; t < gNumLinks; t++) n += gLinks[t].count + gLinks[t].inflightCount;
+  return n;
+}
+
+bool rpcConnected() {
+  return sel().wifi.connected();
+}
+
+uint32_t rpcRttMs() {
+  return sel().rttMs;
+}
+
+void rpcSetHost(const IPAddress& ip, uint16_t port) {
+  RpcLink& k = sel();
+  if (ip == k.hostIp && port == k.port) return;
+  k.hostIp = ip;
+  k.port   = port;
+  k.failStreak = 0;
+  rpcReconnect();
+  renderHead(k);
+}
+
+IPAddress rpcHost() {
+  return sel().hostIp;
+}
+
+uint16_t rpcPort() {
+  return sel().port;
+}
+
+uint8_t rpcFailStreak() {
+  return sel().failStreak;
+}
+
+void rpcReconnect() {
+  RpcLink& k = sel();
+  stats(k).reconnects++;
+  failAllInflight(k);
+  k.wifi.stop();
+  resetRx(k);
+  k.txLen = k.txOff = 0;
+  k.backoffMs = RPC_BACKOFF_MIN_MS;
+  k.nextConnectMs = millis();
+}
+
+void rpcPoll() {
+  // each target in turn, with it selected for the callbacks
+  uint8_t was = gSelected;
+  for (uint8_t t = 0; t < gNumLinks; t++) {
+    if (!gLinks[t].begun) continue;
+    gSelected = t;
+    pollLink(gLinks[t]);
+  }
+  gSelected = was;
+}
@@ -0,0 +1,152 @@
+/*
+  Kodi JSON-RPC send queue
+
+  Button handlers push requests into a small fixed-capacity queue and return
+  right away. rpcPoll() is called on every loop() pass and drives a state
+  machine (connect / write / read response / done) one step at a time.
+  Writes and reads never wait. The connect does wait for the handshake,
+  since the ESP8266 WiFiClient has no non-blocking one. It is capped at
+  100 ms, and the capture ring keeps every edge meanwhile, so IR is
+  never lost, only decoded a little later.
+
+  One socket per Kodi target is kept open and re-established in the
+  background. rpcPoll() advances every target in turn; each has its own
+  queue, request buffer and reply scanner, so sends to several boxes run
+  side by side and a slow one doesn't delay the others. Two transports
+  are supported:
+  - RPC_HTTP: POST to /jsonrpc. The fixed part of the request head (request
+    line, Host, Authorization, Content-Type) is rendered once by rpcBegin();
+    each call only adds its Content-Length and body. One call in flight.
+    Replies may come with a Content-Length, chunked or close delimited.
+  - RPC_TCP: Kodi's raw JSON-RPC socket (port 9090). Requests are written
+    back to back without waiting and replies are matched by a rising id.
+
+  rpcEnqueueBatch() sends several payloads as one JSON-RPC batch (one
+  round trip, one reply holding an array of responses).
+
+  Navigation steps (rpcEnqueueStep) are coalesced: only one is in flight
+  at a time, the ones that come in meanwhile merge into the waiting call,
+  which goes out as a JSON-RPC batch. A slow Kodi gets fewer, bigger
+  requests instead of a growing queue.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "json_sax.h"
+
+// ===== Targets =====
+// Each Kodi box is a target. Every call below except rpcPoll() and
+// rpcPendingAll() acts on the selected target, 0 unless rpcSelect() said
+// otherwise. Reply, message and notify callbacks run with their own
+// target selected.
+const uint8_t RPC_TARGETS_MAX = 2;
+
+void    rpcSelect(uint8_t target);
+uint8_t rpcSelected();
+
+// Targets set up with rpcBegin()
+uint8_t rpcTargets();
+
+// Selects target for the rest of the scope
+struct RpcScope {
+  uint8_t was;
+  explicit RpcScope(uint8_t target) : was(rpcSelected()) { rpcSelect(target); }
+  ~RpcScope() { rpcSelect(was); }
+};
+
+// ===== Queue sizing =====
+const size_t RPC_QUEUE_LEN    = 8;
+const size_t RPC_INFLIGHT_MAX = 4;   // pipelining depth on RPC_TCP
+const size_t RPC_BODY_MAX     = 256;
+const size_t RPC_BATCH_MAX    = 8;   // payloads or steps in one call
+
+enum RpcTransport : uint8_t {
+  RPC_HTTP,
+  RPC_TCP
+};
+
+// A request body stored in flash, see payloads.h. It ends with "id": and
+// the transport appends the call's id and the closing brace.
+struct RpcPayload {
+  PGM_P       json;
+  uint16_t    len;
+  const char* label;
+  uint8_t     id;        // PayloadId, for the per-method counters
+};
+
+// Called once a request has finished. ok is false if it failed (connect
+// error, timeout, HTTP status other than 200). Replies aren't kept: their
+// content went to the rpcSetMessageHandler() consumer while it arrived,
+// right before this call.
+typedef void (*RpcReplyFn)(bool ok, uint32_t arg);
+
+// Sets up the selected target: renders its request head and starts connecting. user == nullptr disables
+// auth (only used by RPC_HTTP). host is an IP address; "" waits for
+// rpcSetHost(). user and pass must stay valid.
+void   rpcBegin(RpcTransport transport, const char* host, uint16_t port,
+                const char* user, const char* pass, uint32_t timeoutMs);
+
+// Appends a request to the queue. Returns false if the queue is full.
+bool   rpcEnqueue(const RpcPayload& body, RpcReplyFn onReply = nullptr, uint32_t arg = 0);
+
+// Appends a batch of count payloads (at most RPC_BATCH_MAX) as one call.
+// parts must stay valid until the call completes; static tables do. The
+// reply is the response array.
+bool   rpcEnqueueBatch(const RpcPayload* const* parts, uint8_t count,
+                       RpcReplyFn onReply = nullptr, uint32_t arg = 0);
+
+// Appends count copies of a fire-and-forget step, merging them into the
+// last queued call if that is the same step and hasn't been sent. Returns
+// false if the step was dropped because the batch is full.
+bool   rpcEnqueueStep(const RpcPayload& body, uint8_t count = 1);
+
+// Called after a message without an id, i.e. a notification on RPC_TCP,
+// has been scanned. The handlers are shared by all targets.
+typedef void (*RpcNotifyFn)();
+void   rpcSetNotifyHandler(RpcNotifyFn fn);
+
+// Connecting blocks loop() for the handshake, up to 100 ms when the box
+// doesn't answer. A target with nothing queued only reconnects in the
+// background while fn returns true, e.g. between presses. nullptr: always.
+typedef bool (*RpcGateFn)();
+void   rpcSetConnectGate(RpcGateFn fn);
+
+// Sees every incoming message (replies and notifications) while it is
+// scanned, before its reply callback or the notify handler runs
+void   rpcSetMessageHandler(JsonSaxFn fn, void* ctx = nullptr);
+
+// Switches to another Kodi: reconnects there, queued calls follow
+void      rpcSetHost(const IPAddress& ip, uint16_t port);
+IPAddress rpcHost();
+uint16_t  rpcPort();
+
+// Failed connects and timeouts since the last reply, for failover
+uint8_t   rpcFailStreak();
+
+// Drops the connection (failing calls in flight, queued ones stay) and
+// reconnects in the background, which releases the socket's buffers
+void   rpcReconnect();
+
+// Advances every target's transport state machine a little. Never blocks
+// on a reply.
+void   rpcPoll();
+
+// Calls waiting to be written
+size_t rpcQueued();
+
+// Calls waiting or in flight
+size_t rpcPending();
+
+// The same, summed over all targets
+size_t rpcPendingAll();
+
+// True while the socket to Kodi is open
+bool   rpcConnected();
+
+// Static buffers (queue, in-flight slots, request buffer, scanner) of all targets
+extern const size_t kRpcRamBytes;
+
+// Smoothed round trip of answered calls, 0 before the first reply
+uint32_t rpcRttMs();
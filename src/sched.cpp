@@ -0,0 +1,48 @@
+#include "sched.h"
+
+#include <coredecls.h>
+
+#include "timer_wheel.h"
+
+static volatile bool sWake = false;
+
+// ===== Stats =====
+static uint32_t      gSleeps  = 0;
+static uint32_t      gEarly   = 0;   // ended by a wake
+static uint64_t      gSleptUs = 0;
+static unsigned long gSinceMs = 0;
+
+void ICACHE_RAM_ATTR schedWake() {
+  sWake = true;
+  esp_schedule();
+}
+
+void schedSleep(uint32_t maxMs) {
+  uint32_t ms = timerNextMs(maxMs);
+  if (sWake || ms == 0) {
+    sWake = false;
+    yield();
+    return;
+  }
+
+  unsigned long startUs = micros();
+  esp_delay(ms, []() { return !sWake; });
+  gSleptUs += micros() - startUs;
+  gSleeps++;
+  if (sWake) gEarly++;
+  sWake = false;
+}
+
+void schedPrint(Print& out) {
+  uint32_t elapsedMs = millis() - gSinceMs;
+  out.printf("=== Loop ===\n");
+  out.printf("sleeps %lu (%lu woken early), asleep %lu%% of the time\n", (unsigned long)gSleeps,
+             (unsigned long)gEarly, elapsedMs ? (unsigned long)(gSleptUs / 10 / elapsedMs) : 0UL);
+}
+
+void schedReset() {
+  gSleeps  = 0;
+  gEarly   = 0;
+  gSleptUs = 0;
+  gSinceMs = millis();
+}
@@ -0,0 +1,25 @@
+/*
+  Loop sleep
+
+  A fixed delay at the end of loop() adds its length to every stage and
+  wakes the CPU for nothing. Instead loop() finishes its pass and calls
+  schedSleep(), which suspends the loop task until the earliest of
+  - the next timer on the wheel (gesture windows, release, reconcile)
+  - a wake source: schedWake() from the IR edge interrupt
+  - maxMs, the bound for work that is still polled (sockets, web server)
+
+  While suspended the SDK runs and the radio may modem-sleep. Waking is
+  esp_schedule(), so an edge resumes the loop within microseconds.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+// ISR safe. The next (or current) schedSleep() returns right away.
+void schedWake();
+
+void schedSleep(uint32_t maxMs);
+
+void schedPrint(Print& out);
+void schedReset();
@@ -0,0 +1,213 @@
+#include "settings.h"
+
+#include <LittleFS.h>
+#include <stddef.h>
+
+#include "logger.h"
+
+const char* SETTINGS_PATH = "/config.txt";
+const char* SETTINGS_TMP  = "/config.tmp";
+
+// ===== Keys =====
+enum SettingType : uint8_t {
+  SET_U8,
+  SET_U16,
+  SET_STR,
+  SET_HOST    // a dotted quad, or "" for none
+};
+
+struct SettingKey {
+  const char* name;
+  SettingType type;
+  uint16_t    offset;
+  uint16_t    size;       // SET_STR and SET_HOST: buffer length
+  uint16_t    lo, hi;     // numbers
+  bool        perTarget;  // "host0", "host1", ...: offset into targets[0]
+  bool        secret;     // not printed
+};
+
+#define TIMING(f) (offsetof(Settings, timing) + offsetof(GestureTiming, f))
+#define TARGET(f) (offsetof(Settings, targets) + offsetof(SettingsTarget, f))
+
+static const SettingKey kKeys[] = {
+  { "hold_ms",      SET_U16,  TIMING(holdMs),     0, 100, 3000,  false, false },
+  { "multi_ms",     SET_U16,  TIMING(multiMs),    0, 50,  1000,  false, false },
+  { "repeat_ms",    SET_U16,  TIMING(repeatMs),   0, 50,  1000,  false, false },
+  { "release_pct",  SET_U16,  TIMING(releasePct), 0, 110, 400,   false, false },
+  { "accel_ms",     SET_U16,  TIMING(accelMs),    0, 0,   10000, false, false },
+  { "max_steps",    SET_U8,   TIMING(maxSteps),   0, 1,   32,    false, false },
+  { "tolerance_us", SET_U16,  offsetof(Settings, toleranceUs), 0, 50, 1000, false, false },
+  { "host",         SET_HOST, TARGET(host),       SETTINGS_HOST_LEN, 0, 0, true, false },
+  { "port",         SET_U16,  TARGET(port),       0, 0,   65535, true,  false },   // 0: unused target
+  { "wifi_ssid",    SET_STR,  offsetof(Settings, wifiSsid), SETTINGS_SSID_LEN, 0, 0, false, false },
+  { "wifi_pass",    SET_STR,  offsetof(Settings, wifiPass), SETTINGS_PASS_LEN, 0, 0, false, true  }
+};
+
+// ===== Copies =====
+static Settings  gDefaults;
+static Settings  gBanks[2];
+static Settings* gActive = &gBanks[0];
+static bool      gStaged = false;
+static bool      gReset  = false;
+
+const size_t kSettingsRamBytes = sizeof(gDefaults) + sizeof(gBanks);
+
+static Settings& spare() {
+  return gActive == &gBanks[0] ? gBanks[1] : gBanks[0];
+}
+
+static Settings& stage() {
+  if (!gStaged) spare() = *gActive;
+  gStaged = true;
+  return spare();
+}
+
+// The key and target a name refers to, nullptr if none
+static const SettingKey* findKey(const char* name, uint8_t& target) {
+  for (const SettingKey& k : kKeys) {
+    size_t n = strlen(k.name);
+    if (strncmp(name, k.name, n) != 0) continue;
+    if (!k.perTarget) {
+      if (name[n] == '\0') { target = 0; return &k; }
+      continue;
+    }
+    if (name[n] >= '0' && name[n] < '0' + RPC_TARGETS_MAX && name[n + 1] == '\0') {
+      target = name[n] - '0';
+      return &k;
+    }
+  }
+  return nullptr;
+}
+
+static const uint8_t* field(const Settings& s, const SettingKey& k, uint8_t target) {
+  return (const uint8_t*)&s + k.offset + (k.perTarget ? target * sizeof(SettingsTarget) : 0);
+}
+
+static const char* store(Settings& s, const SettingKey& k, uint8_t target, const char* value) {
+  uint8_t* p = const_cast<uint8_t*>(field(s, k, target));
+  if (k.type == SET_STR || k.type == SET_HOST) {
+    if (strlen(value) >= k.size) return "too long";
+    IPAddress ip;
+    if (k.type == SET_HOST && *value && !ip.fromString(value)) return "not an IP address";
+    strlcpy((char*)p, value, k.size);
+    return nullptr;
+  }
+  char* end;
+  unsigned long v = strtoul(value, &end, 10);
+  if (!*value || *end) return "not a number";
+  if (v < k.lo || v > k.hi) return "out of range";
+  if (k.type == SET_U8) *p = v;
+  else                  *(uint16_t*)p = v;
+  return nullptr;
+}
+
+static void printValue(Print& out, const Settings& s, const SettingKey& k, uint8_t target) {
+  const uint8_t* p = field(s, k, target);
+  if (k.type == SET_U8)       out.printf("%u", *p);
+  else if (k.type == SET_U16) out.printf("%u", *(const uint16_t*)p);
+  else                        out.print((const char*)p);
+}
+
+// Calls fn for every key and target
+template <typename Fn>
+static void eachKey(Fn fn) {
+  for (const SettingKey& k : kKeys) {
+    for (uint8_t t = 0; t < (k.perTarget ? RPC_TARGETS_MAX : 1); t++) fn(k, t);
+  }
+}
+
+static void printLine(Print& out, const Settings& s, const SettingKey& k, uint8_t t) {
+  out.print(k.name);
+  if (k.perTarget) out.printf("%u", t);
+  out.print("=");
+  printValue(out, s, k, t);
+  out.print("\n");
+}
+
+// ===== File =====
+static void load() {
+  File f = LittleFS.open(SETTINGS_PATH, "r");
+  if (!f) return;
+  f.setTimeout(0);   // a last line without a newline ends at EOF
+  char line[96];
+  while (f.available()) {
+    size_t n = f.readBytesUntil('\n', line, sizeof(line) - 1);
+    line[n] = '\0';
+    char* eq = strchr(line, '=');
+    if (!eq) continue;
+    *eq = '\0';
+    const char* err = settingsSet(line, eq + 1);
+    if (err) LOG_W("%s: %s: %s", SETTINGS_PATH, line, err);
+  }
+  f.close();
+}
+
+static void save(const Settings& s) {
+  if (gReset) {
+    LittleFS.remove(SETTINGS_PATH);
+    return;
+  }
+  File f = LittleFS.open(SETTINGS_TMP, "w");
+  if (!f) return;
+  eachKey([&](const SettingKey& k, uint8_t t) { printLine(f, s, k, t); });
+  f.close();
+  // a power cut leaves either the old file or the new one
+  LittleFS.rename(SETTINGS_TMP, SETTINGS_PATH);
+}
+
+// ===== Public =====
+void settingsBegin(const Settings& defaults) {
+  gDefaults = defaults;
+  *gActive  = defaults;
+  gStaged   = false;
+  if (!LittleFS.begin()) return;
+  load();
+  if (!gStaged) return;
+  // taken as they are, nothing to apply or save yet
+  gActive = &spare();
+  gStaged = false;
+}
+
+const Settings& settings() {
+  return *gActive;
+}
+
+const char* settingsSet(const char* key, const char* value) {
+  uint8_t t;
+  const SettingKey* k = findKey(key, t);
+  if (!k) return "unknown key";
+  // checked on a scratch copy so a bad value leaves nothing staged
+  Settings next = gStaged ? spare() : *gActive;
+  const char* err = store(next, *k, t, value);
+  if (err) return err;
+  stage() = next;
+  gReset  = false;
+  return nullptr;
+}
+
+void settingsReset() {
+  stage() = gDefaults;
+  gReset  = true;
+}
+
+bool settingsStaged() {
+  return gStaged;
+}
+
+const Settings* settingsCommit() {
+  if (!gStaged) return nullptr;
+  Settings* was = gActive;
+  gActive = &spare();
+  gStaged = false;
+  save(*gActive);
+  gReset = false;
+  return was;
+}
+
+void settingsPrint(Print& out) {
+  const Settings& s = *gActive;
+  eachKey([&](const SettingKey& k, uint8_t t) {
+    if (!k.secret) printLine(out, s, k, t);
+  });
+  if (gStaged) out.print("# changes staged, applied between presses\n");
+}
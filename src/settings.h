@@ -0,0 +1,61 @@
+/*
+  Live settings
+
+  What used to need a reflash: UX timings, the NEC tolerance, the Kodi
+  targets' addresses and the WiFi credentials. The build's constants are
+  the defaults; /config.txt on LittleFS ("key=value" lines) overrides
+  them at boot, and settingsSet() changes them while running.
+
+  There are two copies. settings() is the active one and is never written
+  to; settingsSet() edits the staged copy, and settingsCommit() swaps the
+  pointer and saves the file. The caller commits between presses and
+  applies only what changed, so a new hold delay doesn't touch the Kodi
+  connections and a new host only reconnects that target. The WiFi
+  credentials take effect at the next boot.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "gesture.h"
+#include "rpc.h"
+
+const size_t SETTINGS_HOST_LEN = 16;   // dotted quad and terminator
+const size_t SETTINGS_SSID_LEN = 33;
+const size_t SETTINGS_PASS_LEN = 65;
+
+struct SettingsTarget {
+  char     host[SETTINGS_HOST_LEN];
+  uint16_t port;                       // of the transport in use
+};
+
+struct Settings {
+  GestureTiming  timing;
+  uint16_t       toleranceUs;
+  SettingsTarget targets[RPC_TARGETS_MAX];
+  char           wifiSsid[SETTINGS_SSID_LEN];
+  char           wifiPass[SETTINGS_PASS_LEN];
+};
+
+// defaults is copied; /config.txt is read over it
+void settingsBegin(const Settings& defaults);
+
+const Settings& settings();
+
+// nullptr if value was taken into the staged copy, else why not
+const char* settingsSet(const char* key, const char* value);
+
+// Stages the build's defaults and removes the file at the next commit
+void settingsReset();
+
+bool settingsStaged();
+
+// Makes the staged copy active and saves it. Returns the one it replaced,
+// valid until the next settingsSet(), or nullptr if nothing was staged.
+const Settings* settingsCommit();
+
+// Every key with its active value; the WiFi password is left out
+void settingsPrint(Print& out);
+
+extern const size_t kSettingsRamBytes;
@@ -0,0 +1,125 @@
+#include "speculate.h"
+
+#include "kodi_state.h"
+#include "logger.h"
+#include "payloads.h"
+#include "rpc.h"
+
+enum SpecState : uint8_t {
+  SPEC_IDLE,
+  SPEC_SENT,       // waiting for the reply
+  SPEC_WATCHING,   // replied with nothing in between, waiting for the next reconcile
+  SPEC_CHECKING    // waiting for the reconcile it asked for
+};
+
+struct SpecGuess {
+  SpecState state;
+  uint8_t   button;
+  uint8_t   trigger;
+  uint8_t   partner;
+  uint8_t   action;
+  uint8_t   target;    // rpc target it went to
+  bool      stale;     // the target's state was stale when it went out
+  uint16_t  events;    // and had seen this many events
+  int8_t    playerId;  // the context it was matched on
+  uint16_t  windowId;
+  bool      fullscreenVideo;
+  uint16_t  seq;
+};
+
+static SpecGuess       gGuess;
+static uint16_t        gSeq = 0;
+static const SpecUndo* gUndos = nullptr;
+static uint8_t         gNumUndos = 0;
+
+// ===== Stats =====
+static uint32_t gSent = 0;
+static uint32_t gChecked = 0;
+static uint32_t gCorrected = 0;
+static uint32_t gUncorrectable = 0;
+
+static const SpecUndo* findUndo(uint8_t action) {
+  for (uint8_t i = 0; i < gNumUndos; i++) {
+    if (gUndos[i].action == action) return &gUndos[i];
+  }
+  return nullptr;
+}
+
+static void onReply(bool ok, uint32_t arg) {
+  if (gGuess.state != SPEC_SENT || arg != gGuess.seq) return;
+  if (!ok) { gGuess.state = SPEC_IDLE; return; }
+  // nothing came in between; over HTTP nothing ever does, so the next
+  // reconcile still has to agree
+  const KodiState& k = kodiState(gGuess.target);
+  if (!gGuess.stale && k.events == gGuess.events) { gGuess.state = SPEC_WATCHING; return; }
+  gGuess.state = SPEC_CHECKING;
+  gChecked++;
+  kodiStateRefresh();
+}
+
+// Our own actions only move the focus, so any of these changing means the
+// context was not what the cache said
+static bool sameContext(const KodiState& k) {
+  return k.playerId == gGuess.playerId && k.windowId == gGuess.windowId &&
+         k.fullscreenVideo == gGuess.fullscreenVideo;
+}
+
+// Runs with the reconciled target selected
+static void onReconciled() {
+  if (rpcSelected() != gGuess.target) return;
+  if (gGuess.state == SPEC_WATCHING) {
+    gGuess.state = SPEC_IDLE;
+    if (sameContext(kodiState(gGuess.target))) return;
+    gChecked++;
+  } else if (gGuess.state == SPEC_CHECKING) {
+    gGuess.state = SPEC_IDLE;
+  } else {
+    return;
+  }
+
+  // matched against the target's own context, whichever one gKodi is on
+  KodiState* was = gKodi;
+  kodiSelect(gGuess.target);
+  const KeyRule* r = keymapMatch(gGuess.button, (KeyTrigger)gGuess.trigger, gGuess.partner);
+  gKodi = was;
+  if (r && r->action == gGuess.action) return;
+  bool sendRight = r && r->action < PL_COUNT;
+
+  const SpecUndo* u = findUndo(gGuess.action);
+  const char* right = sendRight ? keymapActionName(r->action) : "nothing";
+  if (!u) {
+    gUncorrectable++;
+    LOG_W("%s: sent %s on a stale context, should have been %s", keymapButtonName(gGuess.button),
+          keymapActionName(gGuess.action), right);
+    return;
+  }
+  gCorrected++;
+  LOG_I("%s: sent %s on a stale context, correcting to %s", keymapButtonName(gGuess.button),
+        keymapActionName(gGuess.action), right);
+  rpcEnqueue(*kPayloads[u->undo]);
+  if (sendRight) rpcEnqueue(*kPayloads[r->action]);
+}
+
+// ===== Public =====
+void specBegin(const SpecUndo* undos, uint8_t count) {
+  gUndos    = undos;
+  gNumUndos = count;
+  kodiSetReconcileHandler(onReconciled);
+}
+
+bool specSend(const KeyRule& r) {
+  gSeq++;
+  if (!rpcEnqueue(*kPayloads[r.action], onReply, gSeq)) return false;
+  uint8_t target = rpcSelected();
+  const KodiState& k = kodiState(target);
+  gGuess = { SPEC_SENT, r.button, r.trigger, r.partner, r.action, target, k.stale, k.events,
+             k.playerId, k.windowId, k.fullscreenVideo, gSeq };
+  gSent++;
+  return true;
+}
+
+void specPrint(Print& out) {
+  out.printf("=== Speculative actions ===\n");
+  out.printf("sent %lu, rechecked %lu, corrected %lu, not correctable %lu\n", (unsigned long)gSent,
+             (unsigned long)gChecked, (unsigned long)gCorrected, (unsigned long)gUncorrectable);
+}
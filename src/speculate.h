@@ -0,0 +1,44 @@
+/*
+  Speculative dispatch
+
+  Context rules (DOWN opens the OSD in fullscreen video, SELECT is
+  play/pause in pure fullscreen) are matched against the cached Kodi
+  state, so the action goes out at once instead of after a query. The
+  cache can be behind: a Player notification came in but the reconcile
+  that confirms the window is still pending, or a notification arrives
+  while the action is on its way.
+
+  specSend() sends the action of such a rule and remembers it. If the
+  cache was stale when it went out, or a notification arrived before its
+  reply (Kodi replies before acting, so anything after the reply is the
+  action's own effect), Kodi is queried right away and the rule matched
+  again. Otherwise the rule is matched again only if the next reconcile
+  finds a different player, window or fullscreen state than the guess
+  used; over HTTP, which has no notifications, that is the only check. When another action should have gone out, the wrong one is taken
+  back with its entry in the undo table and the right one is sent.
+  Actions without an undo entry are only counted.
+
+  Only the latest speculative action is tracked, on whichever rpc target
+  it went to.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "keymap.h"
+
+// Takes back action by sending undo (e.g. a toggle sends itself)
+struct SpecUndo {
+  uint8_t action;
+  uint8_t undo;
+};
+
+// undos must stay valid; a static table does
+void specBegin(const SpecUndo* undos, uint8_t count);
+
+// Sends the action of r, which was matched from the cached context, to
+// the selected rpc target
+bool specSend(const KeyRule& r);
+
+void specPrint(Print& out);
@@ -0,0 +1,43 @@
+#include "syslog.h"
+
+#include <WiFiUdp.h>
+
+#include "logger.h"
+#include "wifi_link.h"
+
+const uint8_t SYSLOG_FACILITY = 16;   // local0
+
+// Syslog severity of each log level
+static const uint8_t kSeverity[] = { 7, 3, 4, 6, 7 };
+
+static WiFiUDP     gUdp;
+static IPAddress   gHost;
+static uint16_t    gPort = 514;
+static const char* gTag  = "";
+
+// ===== Stats =====
+static uint32_t gSent   = 0;
+static uint32_t gFailed = 0;
+
+static void sendLine(uint8_t level, const char* line) {
+  if (!wifiLinkUp()) return;
+  uint8_t sev = level < sizeof(kSeverity) ? kSeverity[level] : 7;
+  bool ok = gUdp.beginPacket(gHost, gPort) && gUdp.printf("<%u>%s: %s", SYSLOG_FACILITY * 8 + sev, gTag, line) &&
+            gUdp.endPacket();
+  if (ok) gSent++;
+  else    gFailed++;
+}
+
+bool syslogBegin(const char* host, uint16_t port, const char* tag) {
+  if (!host || !*host || !gHost.fromString(host)) return false;
+  gPort = port;
+  gTag  = tag;
+  logSetSink(sendLine);
+  return true;
+}
+
+void syslogPrint(Print& out) {
+  if (!gHost.isSet()) return;
+  out.printf("syslog %s:%u, sent %lu, failed %lu\n", gHost.toString().c_str(), gPort, (unsigned long)gSent,
+             (unsigned long)gFailed);
+}
@@ -0,0 +1,17 @@
+/*
+  Syslog sink
+
+  Sends each log line as it leaves the ring to a syslog server over UDP
+  (RFC 3164 framing, facility local0, no timestamp so the server stamps
+  it), for watching a box that has no serial cable attached. Lines
+  logged while WiFi is down only go to Serial.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+// host is a dotted address; "" leaves the sink off. tag must stay valid.
+bool syslogBegin(const char* host, uint16_t port, const char* tag);
+
+void syslogPrint(Print& out);
@@ -0,0 +1,124 @@
+#include "timer_wheel.h"
+
+static_assert((TIMER_SLOTS & (TIMER_SLOTS - 1)) == 0, "slot count must be a power of two");
+
+// Each slot is the sentinel of a circular list
+static Timer    gSlots[TIMER_SLOTS];
+static uint32_t gTick  = 0;   // last tick processed
+static bool     gReady = false;
+
+// Ticks run freely from wheelInit() and only ever move forward by the
+// millis() elapsed, so the wrap of millis() after 49.7 days is just
+// another step. Tick numbers are compared by signed difference.
+static uint32_t gNowTick = 0;
+static uint32_t gNowMs   = 0;   // millis() at the start of gNowTick
+
+static uint32_t nowTick() {
+  int32_t elapsed = (int32_t)(millis() - gNowMs);
+  if (elapsed >= (int32_t)TIMER_TICK_MS) {
+    uint32_t ticks = elapsed / TIMER_TICK_MS;
+    gNowTick += ticks;
+    gNowMs   += ticks * TIMER_TICK_MS;
+  }
+  return gNowTick;
+}
+
+static void wheelInit() {
+  for (uint16_t i = 0; i < TIMER_SLOTS; i++) gSlots[i].next = gSlots[i].prev = &gSlots[i];
+  gNowMs = millis();
+  gTick  = gNowTick;
+  gReady = true;
+}
+
+static void unlink(Timer& t) {
+  t.prev->next = t.next;
+  t.next->prev = t.prev;
+  t.next = t.prev = nullptr;
+}
+
+static void link(Timer& head, Timer& t) {
+  t.prev = head.prev;
+  t.next = &head;
+  head.prev->next = &t;
+  head.prev = &t;
+}
+
+void timerInit(Timer& t, TimerFn fn, uint32_t arg) {
+  if (timerArmed(t)) unlink(t);
+  t.fn  = fn;
+  t.arg = arg;
+}
+
+void timerArm(Timer& t, uint32_t delayMs) {
+  if (!gReady) wheelInit();
+  if (timerArmed(t)) unlink(t);
+  uint32_t ticks = (delayMs + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+  // from now, not from the last processed tick: after a stalled loop the
+  // wheel lags behind and would fire it early by the stall. Always at
+  // least one tick ahead of the last processed one.
+  t.due = ticks ? nowTick() + ticks : gTick + 1;
+  link(gSlots[t.due & (TIMER_SLOTS - 1)], t);
+}
+
+void timerCancel(Timer& t) {
+  if (timerArmed(t)) unlink(t);
+}
+
+// Signed, negative once tick has started
+static int32_t msTo(uint32_t tick) {
+  int32_t ticks = (int32_t)(tick - nowTick());
+  return ticks * (int32_t)TIMER_TICK_MS - (int32_t)(millis() - gNowMs);
+}
+
+static uint32_t msUntil(uint32_t due) {
+  int32_t ms = msTo(due);
+  return ms > 0 ? ms : 0;
+}
+
+uint32_t timerRemainingMs(const Timer& t) {
+  return timerArmed(t) ? msUntil(t.due) : 0;
+}
+
+uint32_t timerNextMs(uint32_t maxMs) {
+  if (!gReady) return maxMs;
+  // slots are walked in due order, so the first lap that has anything due wins
+  for (uint16_t i = 1; i <= TIMER_SLOTS; i++) {
+    uint32_t tick = gTick + i;
+    if (msTo(tick) > (int32_t)maxMs) break;
+    const Timer& head = gSlots[tick & (TIMER_SLOTS - 1)];
+    for (const Timer* t = head.next; t != &head; t = t->next) {
+      if (t->due == tick) {
+        uint32_t ms = msUntil(tick);
+        return ms < maxMs ? ms : maxMs;
+      }
+    }
+  }
+  return maxMs;
+}
+
+void timerPoll() {
+  if (!gReady) wheelInit();
+  uint32_t now = nowTick();
+  while ((int32_t)(now - gTick) > 0) {
+    gTick++;
+    Timer& head = gSlots[gTick & (TIMER_SLOTS - 1)];
+
+    // move the slot aside, so callbacks re-arming into it can't loop forever
+    Timer pending;
+    pending.next = pending.prev = &pending;
+    if (head.next != &head) {
+      pending.next = head.next;
+      pending.prev = head.prev;
+      pending.next->prev = &pending;
+      pending.prev->next = &pending;
+      head.next = head.prev = &head;
+    }
+
+    while (pending.next != &pending) {
+      Timer& t = *pending.next;
+      unlink(t);
+      if (t.due == gTick) t.fn(t.arg);
+      else link(head, t);   // a later lap
+    }
+  }
+}
@@ -0,0 +1,46 @@
+/*
+  Timer wheel
+
+  One hashed wheel of TIMER_SLOTS slots, TIMER_TICK_MS apart, for the
+  one-shot deadlines the firmware needs (multi-tap windows, missing
+  repeats, reconciles). Timers are caller-owned and linked into their slot, so arming
+  and cancelling never allocate and timerPoll() only looks at the slots
+  whose tick has passed. Deadlines beyond one turn of the wheel just stay
+  in their slot until the right lap.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+const uint32_t TIMER_TICK_MS = 5;
+const uint16_t TIMER_SLOTS   = 64;   // one lap = 320 ms
+
+typedef void (*TimerFn)(uint32_t arg);
+
+struct Timer {
+  Timer*   next = nullptr;   // slot list, nullptr while idle
+  Timer*   prev = nullptr;
+  uint32_t due  = 0;         // tick
+  TimerFn  fn   = nullptr;
+  uint32_t arg  = 0;
+};
+
+void timerInit(Timer& t, TimerFn fn, uint32_t arg = 0);
+
+// (Re)arms t to fire once, delayMs from now (rounded up to a tick)
+void timerArm(Timer& t, uint32_t delayMs);
+
+void timerCancel(Timer& t);
+
+inline bool timerArmed(const Timer& t) { return t.next != nullptr; }
+
+// ms until t fires, 0 if it is idle or overdue
+uint32_t timerRemainingMs(const Timer& t);
+
+// ms until the earliest armed timer is due, maxMs if none is sooner. The
+// loop sleeps this long.
+uint32_t timerNextMs(uint32_t maxMs);
+
+// Fires everything that is due. Callbacks may arm or cancel any timer.
+void timerPoll();
@@ -0,0 +1,181 @@
+#include "web.h"
+
+#include <ESP8266WiFi.h>
+
+// ===== Limits =====
+// Every /config key at its longest, the WiFi ones fully %XX encoded,
+// is about 500 bytes
+const size_t   WEB_LINE_MAX   = 640;
+const uint32_t WEB_TIMEOUT_MS = 1000;
+
+// ===== Output buffer =====
+class WebBuffer : public Print {
+ public:
+  size_t write(uint8_t c) override {
+    if (len >= WEB_OUT_MAX) return 0;
+    data[len++] = c;
+    return 1;
+  }
+  size_t write(const uint8_t* buf, size_t n) override {
+    size_t room = WEB_OUT_MAX - len;
+    if (n > room) n = room;
+    memcpy(data + len, buf, n);
+    len += n;
+    return n;
+  }
+
+  uint8_t data[WEB_OUT_MAX];
+  size_t  len = 0;
+};
+
+struct WebRoute {
+  const char* path;
+  WebHandler  fn;
+};
+
+enum WebState : uint8_t {
+  WEB_IDLE,
+  WEB_REQUEST,
+  WEB_RESPOND
+};
+
+static WiFiServer    gServer(80);
+static WiFiClient    gClient;
+static WebState      gState = WEB_IDLE;
+static unsigned long gStartMs = 0;
+
+static WebRoute gRoutes[WEB_ROUTES_MAX];
+static uint8_t  gNumRoutes = 0;
+
+static char     gLine[WEB_LINE_MAX];
+static uint16_t gLineLen  = 0;
+static bool     gLineLong = false;   // didn't fit, answered with 414
+static WebBuffer gOut;
+static size_t   gOutOff = 0;
+
+const size_t kWebRamBytes = sizeof(gRoutes) + sizeof(gLine) + sizeof(gOut);
+
+static void closeClient() {
+  // unread request headers would make lwIP reset instead of close
+  while (gClient.available() > 0) gClient.read();
+  gClient.stop();
+  gState = WEB_IDLE;
+}
+
+static void reject(const char* status) {
+  gOut.len = 0;
+  gOutOff  = 0;
+  gOut.printf("HTTP/1.0 %s\r\nConnection: close\r\n\r\n", status);
+  gState = WEB_RESPOND;
+}
+
+static void route() {
+  // "GET /path?query HTTP/1.1"
+  char* path = strchr(gLine, ' ');
+  if (path) {
+    path++;
+    char* end = strchr(path, ' ');
+    if (end) *end = '\0';
+  }
+  const char* query = "";
+  if (path) {
+    char* q = strchr(path, '?');
+    if (q) { *q = '\0'; query = q + 1; }
+  }
+
+  gOut.len = 0;
+  gOutOff  = 0;
+  for (uint8_t i = 0; path && i < gNumRoutes; i++) {
+    if (strcmp(gRoutes[i].path, path) != 0) continue;
+    gOut.print("HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\n");
+    gRoutes[i].fn(gOut, query);
+    gState = WEB_RESPOND;
+    return;
+  }
+  reject("404 Not Found");
+}
+
+// ===== Query =====
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// Decodes up to one of stops into out; returns where it stopped
+static const char* decode(const char* p, const char* stops, char* out, size_t len) {
+  size_t n = 0;
+  for (; *p && !strchr(stops, *p); p++) {
+    char c = *p;
+    if (c == '+') c = ' ';
+    else if (c == '%' && hexDigit(p[1]) >= 0 && hexDigit(p[2]) >= 0) {
+      c = hexDigit(p[1]) << 4 | hexDigit(p[2]);
+      p += 2;
+    }
+    if (n + 1 < len) out[n++] = c;
+  }
+  out[n] = '\0';
+  return p;
+}
+
+bool webParam(const char*& query, char* key, size_t keyLen, char* value, size_t valueLen) {
+  if (!*query) return false;
+  const char* p = decode(query, "=&", key, keyLen);
+  value[0] = '\0';
+  if (*p == '=') p = decode(p + 1, "&", value, valueLen);
+  query = *p ? p + 1 : p;
+  return true;
+}
+
+void webBegin(uint16_t port) {
+  gServer.begin(port);
+  gServer.setNoDelay(true);
+}
+
+bool webOn(const char* path, WebHandler fn) {
+  if (gNumRoutes >= WEB_ROUTES_MAX) return false;
+  gRoutes[gNumRoutes++] = { path, fn };
+  return true;
+}
+
+void webPoll() {
+  switch (gState) {
+    case WEB_IDLE:
+      gClient = gServer.accept();
+      if (!gClient) return;
+      gClient.setNoDelay(true);
+      gLineLen  = 0;
+      gLineLong = false;
+      gStartMs  = millis();
+      gState = WEB_REQUEST;
+      break;
+
+    case WEB_REQUEST:
+      while (gClient.available() > 0) {
+        int ch = gClient.read();
+        if (ch == '\n') {
+          if (gLineLen > 0 && gLine[gLineLen - 1] == '\r') gLineLen--;
+          gLine[gLineLen] = '\0';
+          // a cut query could still parse, and save half a password
+          if (gLineLong) reject("414 URI Too Long");
+          else route();
+          break;
+        }
+        if (gLineLen < WEB_LINE_MAX - 1) gLine[gLineLen++] = (char)ch;
+        else gLineLong = true;
+      }
+      break;
+
+    case WEB_RESPOND: {
+      size_t room = gClient.availableForWrite();
+      size_t left = gOut.len - gOutOff;
+      size_t n = room < left ? room : left;
+      if (n > 0) gOutOff += gClient.write(gOut.data + gOutOff, n);
+      if (gOutOff >= gOut.len) closeClient();
+      break;
+    }
+  }
+
+  if (gState != WEB_IDLE && (!gClient.connected() || millis() - gStartMs > WEB_TIMEOUT_MS)) closeClient();
+}
@@ -0,0 +1,28 @@
+/*
+  Tiny non-blocking HTTP server for diagnostics
+
+  One client at a time. webPoll() reads the request line, renders the
+  matching handler into a static buffer and then sends that buffer as
+  socket space becomes available, so a request never stalls loop().
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+const size_t WEB_OUT_MAX    = 4096;   // fits /metrics with every counter at 10 digits
+const size_t WEB_ROUTES_MAX = 6;
+
+// query is the part after '?', or "" if there is none
+typedef void (*WebHandler)(Print& out, const char* query);
+
+void webBegin(uint16_t port);
+bool webOn(const char* path, WebHandler fn);
+void webPoll();
+
+// Takes the next "key=value" off query, with %XX and '+' decoded; a
+// parameter without '=' has an empty value. False when none is left.
+bool webParam(const char*& query, char* key, size_t keyLen, char* value, size_t valueLen);
+
+// Static buffers (routes, request line, output)
+extern const size_t kWebRamBytes;
@@ -0,0 +1,185 @@
+#include "wifi_link.h"
+
+#include <LittleFS.h>
+
+#include "logger.h"
+
+// ===== Saved join data =====
+const uint32_t WIFI_CACHE_MAGIC = 0x57464331;   // "WFC1"
+const uint32_t WIFI_RTC_BLOCK   = 0;            // RTC user memory, 4 byte blocks
+const char*    WIFI_CACHE_PATH  = "/wifi.bin";
+
+// Laid out without padding; RTC memory takes whole 4 byte blocks
+struct WifiCache {
+  uint32_t magic;
+  uint8_t  bssid[6];
+  uint8_t  channel;
+  uint8_t  reserved;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t crc;
+};
+static_assert(sizeof(WifiCache) == 32, "WifiCache must stay 8 RTC blocks");
+
+enum LinkState : uint8_t {
+  LINK_FAST,     // joining the saved BSSID/channel with a static address
+  LINK_FULL,     // scan and DHCP
+  LINK_UP
+};
+
+static WifiLinkConfig gCfg;
+static char           gSsid[33];          // gCfg points here
+static char           gPass[65];
+static WifiCache      gCache;
+static bool           gCacheValid = false;
+static LinkState      gState = LINK_FULL;
+static unsigned long  gJoinStartMs = 0;
+static uint32_t       gJoinMs = 0;        // duration of the last successful join
+static bool           gJoinFast = false;
+static unsigned long  gFirstUpMs = 0;
+static uint16_t       gDrops = 0;
+static uint16_t       gFastFails = 0;
+
+// ===== Cache =====
+static uint32_t crc32(const uint8_t* p, size_t n) {
+  uint32_t crc = 0xFFFFFFFF;
+  while (n--) {
+    crc ^= *p++;
+    for (uint8_t i = 0; i < 8; i++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static uint32_t cacheCrc(const WifiCache& c) {
+  return crc32((const uint8_t*)&c, offsetof(WifiCache, crc));
+}
+
+static bool cacheOk(const WifiCache& c) {
+  return c.magic == WIFI_CACHE_MAGIC && c.crc == cacheCrc(c) && c.channel > 0;
+}
+
+static bool loadCache() {
+  if (ESP.rtcUserMemoryRead(WIFI_RTC_BLOCK, (uint32_t*)&gCache, sizeof(gCache)) && cacheOk(gCache))
+    return true;
+
+  File f = LittleFS.open(WIFI_CACHE_PATH, "r");
+  if (!f) return false;
+  bool ok = f.read((uint8_t*)&gCache, sizeof(gCache)) == sizeof(gCache) && cacheOk(gCache);
+  f.close();
+  if (ok) ESP.rtcUserMemoryWrite(WIFI_RTC_BLOCK, (uint32_t*)&gCache, sizeof(gCache));
+  return ok;
+}
+
+static void saveCache() {
+  WifiCache c;
+  memset(&c, 0, sizeof(c));
+  c.magic = WIFI_CACHE_MAGIC;
+  memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+  c.channel = WiFi.channel();
+  c.ip      = WiFi.localIP();
+  c.gateway = WiFi.gatewayIP();
+  c.subnet  = WiFi.subnetMask();
+  c.dns     = WiFi.dnsIP(0);
+  c.crc     = cacheCrc(c);
+
+  // flash only takes a write when the AP or the lease changed
+  if (gCacheValid && memcmp(&c, &gCache, sizeof(c)) == 0) return;
+  gCache = c;
+  gCacheValid = true;
+  ESP.rtcUserMemoryWrite(WIFI_RTC_BLOCK, (uint32_t*)&gCache, sizeof(gCache));
+  File f = LittleFS.open(WIFI_CACHE_PATH, "w");
+  if (!f) return;
+  f.write((const uint8_t*)&gCache, sizeof(gCache));
+  f.close();
+}
+
+static void dropCache() {
+  gCacheValid = false;
+  memset(&gCache, 0, sizeof(gCache));
+  ESP.rtcUserMemoryWrite(WIFI_RTC_BLOCK, (uint32_t*)&gCache, sizeof(gCache));
+  LittleFS.remove(WIFI_CACHE_PATH);
+}
+
+// ===== Joining =====
+static void startJoin(bool fast) {
+  gState = fast ? LINK_FAST : LINK_FULL;
+  gJoinStartMs = millis();
+
+  bool fixed = (uint32_t)gCfg.ip != 0;
+  if (fixed) {
+    WiFi.config(gCfg.ip, gCfg.gateway, gCfg.subnet, gCfg.dns);
+  } else if (fast) {
+    WiFi.config(IPAddress(gCache.ip), IPAddress(gCache.gateway), IPAddress(gCache.subnet), IPAddress(gCache.dns));
+  } else {
+    WiFi.config(IPAddress(), IPAddress(), IPAddress());   // back to DHCP
+  }
+
+  if (fast) WiFi.begin(gCfg.ssid, gCfg.pass, gCache.channel, gCache.bssid, true);
+  else      WiFi.begin(gCfg.ssid, gCfg.pass);
+}
+
+static void linkUp() {
+  gJoinMs   = millis() - gJoinStartMs;
+  gJoinFast = gState == LINK_FAST;
+  gState    = LINK_UP;
+  if (!gFirstUpMs) gFirstUpMs = millis();
+  saveCache();
+  LOG_I("WiFi up (%s join, %lu ms), IP %s", gJoinFast ? "fast" : "full",
+        (unsigned long)gJoinMs, WiFi.localIP().toString().c_str());
+}
+
+// ===== Public =====
+void wifiLinkBegin(const WifiLinkConfig& cfg) {
+  gCfg = cfg;
+  strlcpy(gSsid, cfg.ssid, sizeof(gSsid));
+  strlcpy(gPass, cfg.pass, sizeof(gPass));
+  gCfg.ssid = gSsid;
+  gCfg.pass = gPass;
+  WiFi.persistent(false);        // the SDK would rewrite its flash config on every begin
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);  // drops are handled here
+  LittleFS.begin();
+  gCacheValid = loadCache();
+  startJoin(gCacheValid);
+}
+
+void wifiLinkPoll() {
+  bool connected = WiFi.status() == WL_CONNECTED;
+
+  if (gState == LINK_UP) {
+    if (connected) return;
+    gDrops++;
+    LOG_W("WiFi lost, rejoining");
+    startJoin(gCacheValid);
+    return;
+  }
+
+  if (connected) { linkUp(); return; }
+
+  uint32_t timeout = gState == LINK_FAST ? gCfg.fastTimeoutMs : gCfg.fullTimeoutMs;
+  if (millis() - gJoinStartMs < timeout) return;
+  if (gState == LINK_FAST) {
+    // moved AP, new channel or lease: forget it and join the slow way
+    gFastFails++;
+    LOG_I("WiFi fast join failed, scanning");
+    dropCache();
+  }
+  startJoin(false);
+}
+
+bool wifiLinkUp() {
+  return gState == LINK_UP;
+}
+
+void wifiLinkPrint(Print& out) {
+  out.printf("=== WiFi ===\n");
+  if (gState == LINK_UP)
+    out.printf("up, last join %s in %lu ms, channel %d, RSSI %d dBm\n", gJoinFast ? "fast" : "full",
+               (unsigned long)gJoinMs, (int)WiFi.channel(), (int)WiFi.RSSI());
+  else
+    out.printf("joining (%s)\n", gState == LINK_FAST ? "fast" : "full");
+  out.printf("first up %lu ms after boot, drops %u, fast join failures %u\n",
+             gFirstUpMs, gDrops, gFastFails);
+}
@@ -0,0 +1,39 @@
+/*
+  WiFi link
+
+  Joining with a scan and DHCP takes seconds. After the first successful
+  join the access point (BSSID, channel) and the IP lease are saved, in
+  RTC memory (survives a reset) and in /wifi.bin on LittleFS (survives a
+  power cut, written only when something changed). The next join goes
+  straight to that BSSID on that channel with the saved address set
+  statically, which usually takes a few hundred ms.
+
+  If the fast join doesn't come up within fastTimeoutMs the saved data is
+  dropped and a normal join runs. A fixed address (ip set) is always used
+  instead of the lease.
+
+  Everything is driven from wifiLinkPoll(), so joins and rejoins after a
+  drop never block loop().
+*/
+
+#pragma once
+
+#include <ESP8266WiFi.h>
+
+struct WifiLinkConfig {
+  const char* ssid;
+  const char* pass;
+  IPAddress   ip;              // 0.0.0.0: the saved DHCP lease
+  IPAddress   gateway;
+  IPAddress   subnet;
+  IPAddress   dns;
+  uint32_t    fastTimeoutMs;
+  uint32_t    fullTimeoutMs;   // then the join starts over
+};
+
+// ssid and pass are copied
+void wifiLinkBegin(const WifiLinkConfig& cfg);
+void wifiLinkPoll();
+
+bool wifiLinkUp();
+void wifiLinkPrint(Print& out);
@@ -0,0 +1,96 @@
+/*
+  Host Arduino API
+
+  The part of the Arduino core the decoder, keymap, gesture and timer
+  wheel use, for the native test environment. The clock is virtual: it
+  only moves when a test advances it (hostAdvanceUs() in host.h), so
+  replays are exact and repeatable. It counts in 64 bits and micros()
+  and millis() wrap like the device's do, at 2^32. Serial output is dropped unless
+  hostSerialEcho is set.
+*/
+
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ICACHE_RAM_ATTR
+#define IRAM_ATTR
+#define PROGMEM
+#define PGM_P const char*
+
+// ===== Clock =====
+inline uint64_t gHostUs = 1000000;
+
+inline unsigned long micros() { return (uint32_t)gHostUs; }
+inline unsigned long millis() { return (uint32_t)(gHostUs / 1000); }
+inline void yield() {}
+
+// ===== Print =====
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+
+  virtual size_t write(const uint8_t* buf, size_t n) {
+    for (size_t i = 0; i < n; i++) write(buf[i]);
+    return n;
+  }
+
+  size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t println(const char* s) { return print(s) + print("\n"); }
+  size_t println() { return print("\n"); }
+
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    char buf[256];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (n < 0) return 0;
+    return write((const uint8_t*)buf, (size_t)n < sizeof(buf) ? n : sizeof(buf) - 1);
+  }
+};
+
+inline bool hostSerialEcho = false;
+
+class HostSerial : public Print {
+ public:
+  size_t write(uint8_t c) override {
+    if (hostSerialEcho) putchar(c);
+    return 1;
+  }
+  using Print::write;
+
+  int availableForWrite() { return 128; }   // the ESP8266 UART FIFO
+};
+
+inline HostSerial Serial;
+
+// ===== IPAddress =====
+// Only so network headers parse; nothing on the host talks to Kodi
+class IPAddress {
+ public:
+  IPAddress() {}
+  IPAddress(uint32_t addr) : mAddr(addr) {}
+  operator uint32_t() const { return mAddr; }
+  bool isSet() const { return mAddr != 0; }
+
+ private:
+  uint32_t mAddr = 0;
+};
+
+// ===== String helpers the ESP8266 libc has =====
+inline size_t strlcpy(char* dst, const char* src, size_t n) {
+  size_t len = strlen(src);
+  if (n) {
+    size_t c = len < n - 1 ? len : n - 1;
+    memcpy(dst, src, c);
+    dst[c] = '\0';
+  }
+  return len;
+}
@@ -0,0 +1,64 @@
+/*
+  Host LittleFS
+
+  Files live in memory. A test puts one in place with hostFsWrite() and
+  the firmware reads it as it would from flash; paths that weren't
+  written fail to open, so without any the keymap falls back to the
+  built-in one and the replays run against the shipped behavior.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+inline std::map<std::string, std::vector<uint8_t>> gHostFiles;
+
+inline void hostFsWrite(const char* path, const void* data, size_t n) {
+  const uint8_t* p = (const uint8_t*)data;
+  gHostFiles[path].assign(p, p + n);
+}
+
+inline void hostFsClear() {
+  gHostFiles.clear();
+}
+
+// Read only, which is all the host build needs
+class File {
+ public:
+  File() {}
+  explicit File(const std::vector<uint8_t>* data) : mData(data) {}
+
+  explicit operator bool() const { return mData != nullptr; }
+
+  int read(uint8_t* buf, size_t n) {
+    if (!mData) return 0;
+    size_t left = mData->size() - mPos;
+    if (n > left) n = left;
+    memcpy(buf, mData->data() + mPos, n);
+    mPos += n;
+    return n;
+  }
+
+  size_t size() { return mData ? mData->size() : 0; }
+  void   close() { mData = nullptr; }
+
+ private:
+  const std::vector<uint8_t>* mData = nullptr;
+  size_t                      mPos  = 0;
+};
+
+class HostFS {
+ public:
+  bool begin() { return true; }
+
+  File open(const char* path, const char*) {
+    auto it = gHostFiles.find(path);
+    return it == gHostFiles.end() ? File() : File(&it->second);
+  }
+};
+
+inline HostFS LittleFS;
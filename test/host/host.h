@@ -0,0 +1,27 @@
+/*
+  Host test support
+
+  Drives the virtual clock. Time moves in steps of at most 1 ms and the
+  timer wheel is polled after each, so gesture windows and release
+  timeouts fire at the same point of a replay as they would in loop().
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include "timer_wheel.h"
+
+inline void hostAdvanceUs(uint32_t us) {
+  while (us > 0) {
+    uint32_t step = 1000 - gHostUs % 1000;
+    if (step > us) step = us;
+    gHostUs += step;
+    us -= step;
+    timerPoll();
+  }
+}
+
+inline void hostAdvanceMs(uint32_t ms) {
+  hostAdvanceUs(ms * 1000);
+}
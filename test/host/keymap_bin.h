@@ -0,0 +1,34 @@
+// Generated from tools/keymap.txt by tools/mkkeymap.py --header, do not edit
+
+#pragma once
+
+#include <stdint.h>
+
+const uint8_t kKeymapBin[] = {
+  0x4B, 0x4D, 0x41, 0x50, 0x02, 0x02, 0x01, 0x07, 0x16, 0x00, 0x00, 0x00,
+  0x64, 0x65, 0x66, 0x61, 0x75, 0x6C, 0x74, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x6D, 0x75, 0x73, 0x69, 0x63, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0xEE, 0x87, 0x00, 0xFF, 0x61, 0x70, 0x70, 0x6C, 0x65, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x4D, 0x45,
+  0x4E, 0x55, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5F,
+  0x00, 0x00, 0x00, 0x00, 0x50, 0x4C, 0x41, 0x59, 0x5F, 0x50, 0x41, 0x55,
+  0x53, 0x45, 0x00, 0x00, 0x00, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x55, 0x50,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C,
+  0x00, 0x00, 0x00, 0x00, 0x44, 0x4F, 0x57, 0x4E, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x09, 0x00, 0x00, 0x00, 0x00, 0x4C, 0x45,
+  0x46, 0x54, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x06,
+  0x00, 0x00, 0x00, 0x00, 0x52, 0x49, 0x47, 0x48, 0x54, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x5C, 0x00, 0x00, 0x00, 0x00, 0x53, 0x45,
+  0x4C, 0x45, 0x43, 0x54, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF,
+  0x06, 0x00, 0xFD, 0x01, 0x00, 0xFF, 0x04, 0x00, 0x00, 0xFF, 0x00, 0xFF,
+  0x02, 0x00, 0xFE, 0xFF, 0x01, 0xFF, 0x02, 0x00, 0x0B, 0xFF, 0x01, 0xFF,
+  0x04, 0x00, 0x01, 0xFF, 0x02, 0xFF, 0x00, 0x00, 0x02, 0xFF, 0x02, 0xFF,
+  0x03, 0x00, 0x02, 0xFF, 0x03, 0xFF, 0x00, 0x02, 0x07, 0xFF, 0x03, 0xFF,
+  0x00, 0x00, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0x00, 0x03, 0xFF, 0x04, 0xFF,
+  0x01, 0x01, 0x0A, 0xFF, 0x04, 0x02, 0x00, 0x01, 0x0A, 0xFF, 0x04, 0xFF,
+  0x00, 0x00, 0x04, 0xFF, 0x04, 0xFF, 0x03, 0x00, 0x04, 0xFF, 0x05, 0xFF,
+  0x01, 0x01, 0x09, 0xFF, 0x05, 0x02, 0x00, 0x01, 0x09, 0xFF, 0x05, 0xFF,
+  0x00, 0x00, 0x05, 0xFF, 0x05, 0xFF, 0x03, 0x00, 0x05, 0xFF, 0x06, 0x02,
+  0x06, 0x00, 0x08, 0x00, 0x06, 0xFF, 0x02, 0x03, 0x08, 0xFF, 0x06, 0xFF,
+  0x04, 0x04, 0x01, 0xFF, 0x06, 0xFF, 0x04, 0x00, 0x06, 0xFF,
+};
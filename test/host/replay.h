@@ -0,0 +1,241 @@
+/*
+  Trace replay
+
+  A trace is what the capture ISR measures: the time between consecutive
+  edges on the receiver output, the first entry being the idle line
+  before the first edge. traceFrame() and friends build NEC traces with
+  optional jitter; replayRun() plays one through the path the firmware
+  takes (the capture rules of ir_capture.cpp, the ring drain of pollIr(),
+  the decoder, counters, keymap and gesture engine) with the timer wheel running
+  off the virtual clock. Actions the gesture engine emits are logged as
+  text as button, trigger and action, e.g. "UP press:up, UP repeat:up x2".
+
+  traceParse() reads what irTracePrint() dumps on the device, so recorded
+  bursts replay the same way as built ones.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "gesture.h"
+#include "host.h"
+#include "ir_ring.h"
+#include "ir_trace.h"
+#include "keymap.h"
+#include "metrics.h"
+#include "nec_decoder.h"
+
+// ===== Firmware settings (as in main.cpp) =====
+const uint16_t      REPLAY_MIN_PULSE_US = 40;
+const uint32_t      REPLAY_MAX_PULSE_US = 24000;
+const uint16_t      REPLAY_TOLERANCE_US = 220;
+const GestureTiming kReplayTiming       = { 250, 300, 110, 160, 1000, 8 };
+
+// Keys of the built-in Apple remote map
+const uint8_t KEY_MENU   = 0x03;
+const uint8_t KEY_PLAY   = 0x5F;
+const uint8_t KEY_UP     = 0x0A;
+const uint8_t KEY_DOWN   = 0x0C;
+const uint8_t KEY_LEFT   = 0x09;
+const uint8_t KEY_RIGHT  = 0x06;
+const uint8_t KEY_SELECT = 0x5C;
+
+inline uint32_t appleFrame(uint8_t key) {
+  return 0x87EE | (uint32_t)key << 16;
+}
+
+// ===== Traces =====
+struct Trace {
+  std::vector<uint32_t> us;
+  uint32_t idleUs       = 1000000;   // line idle since the last edge
+  uint32_t sinceBurstUs = 0;         // start of the last burst to now
+  uint16_t jitterUs     = 0;         // uniform, +-
+  int16_t  markBiasUs   = 0;         // receivers stretch marks and shrink spaces by this
+  uint32_t seed         = 1;
+};
+
+inline int32_t traceNoise(Trace& t) {
+  if (!t.jitterUs) return 0;
+  t.seed = t.seed * 1103515245 + 12345;
+  return (int32_t)((t.seed >> 16) % (2 * t.jitterUs + 1)) - t.jitterUs;
+}
+
+inline void traceEdge(Trace& t, int32_t us) {
+  if (us < 1) us = 1;
+  t.us.push_back(us);
+  t.sinceBurstUs += us;
+}
+
+inline void traceMark(Trace& t, uint32_t us)  { traceEdge(t, us + t.markBiasUs + traceNoise(t)); }
+inline void traceSpace(Trace& t, uint32_t us) { traceEdge(t, us - t.markBiasUs + traceNoise(t)); }
+
+inline void traceIdle(Trace& t, uint32_t us) {
+  t.idleUs       += us;
+  t.sinceBurstUs += us;
+}
+
+// The idle line ends with the first mark of a burst
+inline void traceBurst(Trace& t) {
+  t.us.push_back(t.idleUs);
+  t.idleUs       = 0;
+  t.sinceBurstUs = 0;
+}
+
+// A full frame, cut off after `bits` bits if fewer than 32
+inline void traceFrame(Trace& t, uint32_t frame, uint8_t bits = 32) {
+  traceBurst(t);
+  traceMark(t, NEC_HDR_MARK_US);
+  traceSpace(t, NEC_HDR_SPACE_US);
+  for (uint8_t i = 0; i < bits; i++) {
+    traceMark(t, NEC_BIT_MARK_US);
+    traceSpace(t, (frame >> i) & 1 ? NEC_ONE_SPACE_US : NEC_ZERO_SPACE_US);
+  }
+  traceMark(t, NEC_BIT_MARK_US);
+}
+
+// A repeat burst on the 108 ms grid of the previous burst
+inline void traceRepeat(Trace& t) {
+  if (t.sinceBurstUs < NEC_REPEAT_PERIOD_US) traceIdle(t, NEC_REPEAT_PERIOD_US - t.sinceBurstUs);
+  traceBurst(t);
+  traceMark(t, NEC_HDR_MARK_US);
+  traceSpace(t, NEC_REPEAT_SPACE_US);
+  traceMark(t, NEC_BIT_MARK_US);
+}
+
+// Press and hold: the frame, then `repeats` repeat bursts
+inline void traceHold(Trace& t, uint32_t frame, uint16_t repeats) {
+  traceFrame(t, frame);
+  while (repeats--) traceRepeat(t);
+}
+
+// Let go: nothing for a while (also the gap between two presses)
+inline void traceRelease(Trace& t, uint32_t ms = 400) {
+  traceIdle(t, ms * 1000);
+}
+
+// Lines of "<start us> <count> <duration us> ... # comment"; the gap
+// before each burst comes from the start times. Returns the bursts read.
+inline uint32_t traceParse(Trace& t, const char* text) {
+  uint32_t bursts = 0;
+  uint32_t endUs  = 0;
+  while (*text) {
+    const char* eol  = strchr(text, '\n');
+    const char* next = eol ? eol + 1 : text + strlen(text);
+    char* p;
+    unsigned long startUs = strtoul(text, &p, 10);
+    unsigned long count   = p != text && *text != '#' ? strtoul(p, &p, 10) : 0;
+    if (count > 0) {
+      uint32_t gapUs = bursts ? (uint32_t)(startUs - endUs) : t.idleUs;
+      t.idleUs = gapUs > REPLAY_MAX_PULSE_US ? gapUs : REPLAY_MAX_PULSE_US + 1;
+      traceBurst(t);
+      endUs = startUs;
+      while (count--) {
+        uint32_t us = strtoul(p, &p, 10);
+        traceEdge(t, us);
+        endUs += us;
+      }
+      bursts++;
+    }
+    text = next;
+  }
+  return bursts;
+}
+
+// ===== Replay =====
+struct ReplayStats {
+  uint32_t  frames;
+  uint32_t  repeats;
+  uint32_t  rejects;
+  NecReject lastReject;
+};
+
+inline NecDecoder    gReplayNec;
+inline ReplayStats   gReplayStats;
+inline std::string   gReplayLog;
+inline unsigned long gReplayFrameStartUs = 0;
+
+inline bool replayAction(const KeyRule& rule, uint8_t steps) {
+  if (!gReplayLog.empty()) gReplayLog += ", ";
+  gReplayLog += keymapButtonName(rule.button);
+  gReplayLog += " ";
+  gReplayLog += keymapTriggerName(rule.trigger);
+  gReplayLog += ":";
+  gReplayLog += keymapActionName(rule.action);
+  if (steps > 1) gReplayLog += " x" + std::to_string(steps);
+  if (rule.action == KEY_ACT_PROFILE_NEXT) keymapNextProfile();
+  return true;
+}
+
+// Once per test program
+inline void replayBegin() {
+  keymapBegin("/keymap.bin");
+  gestureBegin(kReplayTiming, replayAction);
+  necInit(gReplayNec, REPLAY_TOLERANCE_US);
+}
+
+inline void replayClear() {
+  gReplayLog.clear();
+  memset(&gReplayStats, 0, sizeof(gReplayStats));
+}
+
+// One entry of the capture ring, as pollIr() handles it
+inline void replayDrain(uint16_t d) {
+  if (d == IR_FRAME_MARK) {
+    NecEvent ev = necGap(gReplayNec);
+    irTraceResult(ev, gReplayNec);
+    metricsNec(ev, gReplayNec.reject);
+    gMetrics.bursts++;
+    if (ev == NEC_REJECT) {
+      gReplayStats.rejects++;
+      gReplayStats.lastReject = gReplayNec.reject;
+    }
+    gReplayFrameStartUs = micros();
+    irTraceStart(gReplayFrameStartUs);
+    return;
+  }
+  irTraceEdge(d);
+  NecEvent ev = necFeed(gReplayNec, d);
+  irTraceResult(ev, gReplayNec);
+  metricsNec(ev, gReplayNec.reject);
+  switch (ev) {
+    case NEC_FRAME: {
+      gReplayStats.frames++;
+      uint8_t button = keymapLookup(gReplayNec.value);
+      metricsPress(button);
+      gestureFrame(button, gReplayFrameStartUs, 0);
+      break;
+    }
+    case NEC_REPEAT:
+      gReplayStats.repeats++;
+      gestureRepeat(gReplayFrameStartUs);
+      break;
+    case NEC_REJECT:
+      gReplayStats.rejects++;
+      gReplayStats.lastReject = gReplayNec.reject;
+      break;
+    default:
+      break;
+  }
+}
+
+// Plays t, then keeps the line idle until every window has closed
+inline void replayRun(const Trace& t) {
+  replayClear();
+  bool idle = true;
+  for (uint32_t d : t.us) {
+    hostAdvanceUs(d);
+    // the capture ISR's rules for this edge
+    if (idle || d > REPLAY_MAX_PULSE_US) replayDrain(IR_FRAME_MARK);
+    else if (d >= REPLAY_MIN_PULSE_US)   replayDrain(d);
+    idle = false;
+  }
+  hostAdvanceUs(t.idleUs);
+  hostAdvanceMs(1000);
+  replayDrain(IR_FRAME_MARK);
+}
+
+inline const char* replayLog() {
+  return gReplayLog.c_str();
+}
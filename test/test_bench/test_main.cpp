@@ -0,0 +1,165 @@
+// Host benchmarks: decode, lookup and gesture cost per frame
+//
+// Host numbers compare variants and catch regressions, they don't predict
+// the ESP8266: /stats has the decode stage measured on the device.
+
+#include <unity.h>
+
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0ULL
+#endif
+
+#include "kodi_state.h"
+#include "replay.h"
+
+// kodi_state.cpp isn't part of the host build
+static KodiState gCache = { -1, false, 0, false, false, false, 0, 0, false };
+KodiState*       gKodi = &gCache;
+
+const uint32_t BENCH_FRAMES = 200000;
+const uint8_t  BENCH_TRACES = 64;   // distinct jittery frames, cycled
+
+static const uint32_t kFrame = appleFrame(KEY_UP) | 0x12UL << 24;
+
+static std::vector<uint16_t> gBursts[BENCH_TRACES];   // durations after the gap
+static NecDecoder            gNec;
+static volatile uint32_t     gSink;
+static uint32_t              gActions;
+
+// ===== Traces =====
+static void buildBursts(uint16_t jitterUs, bool repeat) {
+  for (uint8_t i = 0; i < BENCH_TRACES; i++) {
+    Trace t;
+    t.jitterUs = jitterUs;
+    t.seed     = i + 1;
+    if (repeat) traceRepeat(t);
+    else        traceFrame(t, kFrame);
+    gBursts[i].assign(t.us.begin() + 1, t.us.end());
+  }
+}
+
+// ===== Cases =====
+// Each returns how many of its n items came out as expected
+static uint32_t runDecode(uint32_t n) {
+  uint32_t ok = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const std::vector<uint16_t>& b = gBursts[i % BENCH_TRACES];
+    necGap(gNec);
+    for (uint16_t d : b) {
+      NecEvent ev = necFeed(gNec, d);
+      if (ev == NEC_FRAME || ev == NEC_REPEAT) ok++;
+    }
+  }
+  return ok;
+}
+
+static uint32_t runReject(uint32_t n) {
+  uint32_t ok = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const std::vector<uint16_t>& b = gBursts[i % BENCH_TRACES];
+    necGap(gNec);
+    for (uint16_t d : b) ok += necFeed(gNec, d) == NEC_REJECT;
+  }
+  return ok;
+}
+
+static uint32_t runLookup(uint32_t n) {
+  static const uint8_t kKeys[] = { KEY_MENU, KEY_PLAY,  KEY_UP,     KEY_DOWN,
+                                   KEY_LEFT, KEY_RIGHT, KEY_SELECT, 0x77 };
+  uint32_t ok = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    uint8_t key = kKeys[i % sizeof(kKeys)];
+    ok += (keymapLookup(appleFrame(key)) == KEY_NONE) == (key == 0x77);
+  }
+  return ok;
+}
+
+static bool countAction(const KeyRule&, uint8_t) {
+  gActions++;
+  return true;
+}
+
+// What loop() does for one frame: decode, look up, hand to the gestures
+static uint32_t runPipeline(uint32_t n) {
+  gActions = 0;
+  for (uint32_t i = 0; i < n; i++) {
+    const std::vector<uint16_t>& b = gBursts[i % BENCH_TRACES];
+    necGap(gNec);
+    for (uint16_t d : b) {
+      if (necFeed(gNec, d) == NEC_FRAME) gestureFrame(keymapLookup(gNec.value), micros(), 0);
+    }
+    timerPoll();
+  }
+  return gActions;
+}
+
+// ===== Runner =====
+static void bench(const char* name, uint32_t (*run)(uint32_t), uint32_t n, uint32_t wantOk) {
+  run(n / 10);   // warm up
+  auto     start  = std::chrono::steady_clock::now();
+  uint64_t cycles = BENCH_CYCLES();
+  uint32_t ok     = run(n);
+  cycles = BENCH_CYCLES() - cycles;
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  gSink = ok;
+
+  char line[128];
+  snprintf(line, sizeof(line), "%-22s %8.1f ns %8.0f cycles  %7.2f M/s", name, ns / n, (double)cycles / n,
+           n / ns * 1000.0);
+  TEST_MESSAGE(line);
+  TEST_ASSERT_EQUAL_UINT32(wantOk, ok);
+}
+
+void setUp() {
+  necInit(gNec, REPLAY_TOLERANCE_US);
+}
+
+void tearDown() {}
+
+void test_decode_clean() {
+  buildBursts(0, false);
+  bench("decode frame", runDecode, BENCH_FRAMES, BENCH_FRAMES);
+}
+
+void test_decode_jittery() {
+  buildBursts(150, false);
+  bench("decode jittery frame", runDecode, BENCH_FRAMES, BENCH_FRAMES);
+}
+
+void test_decode_repeat() {
+  buildBursts(150, true);
+  bench("decode repeat", runDecode, BENCH_FRAMES, BENCH_FRAMES);
+}
+
+void test_reject_noise() {
+  buildBursts(0, false);
+  for (std::vector<uint16_t>& b : gBursts) b[0] = 3000;   // not a header
+  bench("reject noise", runReject, BENCH_FRAMES, BENCH_FRAMES);
+}
+
+void test_lookup() {
+  bench("keymap lookup", runLookup, BENCH_FRAMES * 10, BENCH_FRAMES * 10);
+}
+
+void test_pipeline() {
+  buildBursts(150, false);
+  gestureBegin(kReplayTiming, countAction);
+  bench("frame to action", runPipeline, BENCH_FRAMES, BENCH_FRAMES);
+}
+
+int main() {
+  keymapBegin("/keymap.bin");
+  UNITY_BEGIN();
+  RUN_TEST(test_decode_clean);
+  RUN_TEST(test_decode_jittery);
+  RUN_TEST(test_decode_repeat);
+  RUN_TEST(test_reject_noise);
+  RUN_TEST(test_lookup);
+  RUN_TEST(test_pipeline);
+  return UNITY_END();
+}
@@ -0,0 +1,321 @@
+// Gesture engine: replays through decoder, built-in keymap and gestures
+
+#include <unity.h>
+
+#include <LittleFS.h>
+
+#include "keymap_bin.h"
+#include "kodi_state.h"
+#include "replay.h"
+
+// kodi_state.cpp isn't part of the host build; tests set the context here
+static KodiState gCache;
+KodiState*       gKodi = &gCache;
+
+static std::string repeated(const char* entry, int n) {
+  std::string s;
+  while (n-- > 0) {
+    if (!s.empty()) s += ", ";
+    s += entry;
+  }
+  return s;
+}
+
+void setUp() {
+  *gKodi = { -1, false, 0, false, false, false, 0, 0, false };
+}
+
+void tearDown() {}
+
+void test_press() {
+  Trace t;
+  traceFrame(t, appleFrame(KEY_UP));
+  replayRun(t);
+  TEST_ASSERT_EQUAL_STRING("UP press:up", replayLog());
+}
+
+void test_unknown_key() {
+  Trace t;
+  traceFrame(t, appleFrame(0x77));
+  traceRelease(t);
+  traceFrame(t, 0x1234 | (uint32_t)KEY_UP << 16);
+  replayRun(t);
+  TEST_ASSERT_EQUAL_UINT32(2, gReplayStats.frames);
+  TEST_ASSERT_EQUAL_STRING("", replayLog());
+}
+
+void test_tap_and_hold() {
+  Trace t;
+  traceFrame(t, appleFrame(KEY_PLAY));
+  traceRelease(t);
+  traceHold(t, appleFrame(KEY_PLAY), 3);
+  replayRun(t);
+  TEST_ASSERT_EQUAL_STRING("PLAY_PAUSE tap:playpause, PLAY_PAUSE hold:shutdownmenu", replayLog());
+}
+
+void test_hold_repeats() {
+  // hold starts on the repeat at 216 ms, each later one repeats
+  Trace t;
+  traceHold(t, appleFrame(KEY_UP), 10);
+  replayRun(t);
+  std::string want = "UP press:up, " + repeated("UP repeat:up", 8);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), replayLog());
+}
+
+void test_hold_acceleration() {
+  // steps double every second after the hold started, up to 8
+  Trace t;
+  traceHold(t, appleFrame(KEY_DOWN), 30);
+  replayRun(t);
+  std::string want = "DOWN press:down, " + repeated("DOWN repeat:down", 9) + ", " +
+                     repeated("DOWN repeat:down x2", 9) + ", " + repeated("DOWN repeat:down x4", 9) +
+                     ", DOWN repeat:down x8";
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), replayLog());
+}
+
+void test_double_needs_player() {
+  Trace t;
+  traceFrame(t, appleFrame(KEY_LEFT));
+  traceRelease(t, 150);
+  traceFrame(t, appleFrame(KEY_LEFT));
+  replayRun(t);
+  TEST_ASSERT_EQUAL_STRING("LEFT press:left, LEFT press:left", replayLog());
+
+  gKodi->playerId = 1;
+  replayRun(t);
+  TEST_ASSERT_EQUAL_STRING("LEFT double:stepback", replayLog());
+}
+
+void test_single_after_multi_tap_window() {
+  gKodi->playerId = 1;
+  Trace t;
+  traceFrame(t, appleFrame(KEY_RIGHT));
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_RIGHT));
+  replayRun(t);
+  TEST_ASSERT_EQUAL_STRING("RIGHT press:right, RIGHT press:right", replayLog());
+}
+
+void test_context() {
+  gKodi->playerId        = 1;
+  gKodi->fullscreenVideo = true;
+  Trace t;
+  traceFrame(t, appleFrame(KEY_DOWN));
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_SELECT));
+  replayRun(t);
+  TEST_ASSERT_EQUAL_STRING("DOWN press:osd, SELECT tap:playpause", replayLog());
+}
+
+void test_jittery_hold() {
+  Trace t;
+  t.jitterUs   = 150;
+  t.markBiasUs = 60;
+  t.seed       = 7;
+  traceHold(t, appleFrame(KEY_UP), 10);
+  replayRun(t);
+  TEST_ASSERT_EQUAL_UINT32(0, gReplayStats.rejects);
+  std::string want = "UP press:up, " + repeated("UP repeat:up", 8);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), replayLog());
+}
+
+void test_lost_repeat_releases() {
+  // released before the hold delay when the second repeat went missing,
+  // so it was a tap; the late repeat belongs to nothing
+  Trace t;
+  traceHold(t, appleFrame(KEY_SELECT), 1);
+  traceIdle(t, 2 * NEC_REPEAT_PERIOD_US);
+  traceRepeat(t);
+  replayRun(t);
+  TEST_ASSERT_EQUAL_STRING("SELECT tap:select", replayLog());
+  TEST_ASSERT_EQUAL_UINT32(2, gReplayStats.repeats);
+  TEST_ASSERT_EQUAL_UINT8(KEY_NONE, gestureHeld());
+}
+
+void test_repeats_without_frame() {
+  Trace t;
+  for (int i = 0; i < 20; i++) traceRepeat(t);
+  replayRun(t);
+  TEST_ASSERT_EQUAL_UINT32(20, gReplayStats.repeats);
+  TEST_ASSERT_EQUAL_STRING("", replayLog());
+}
+
+void test_other_key_during_hold() {
+  // a second remote's frame while the first key repeats
+  Trace t;
+  traceHold(t, appleFrame(KEY_UP), 4);
+  traceIdle(t, NEC_REPEAT_PERIOD_US - t.sinceBurstUs);
+  traceFrame(t, appleFrame(KEY_MENU));
+  replayRun(t);
+  TEST_ASSERT_EQUAL_STRING("UP press:up, UP repeat:up, UP repeat:up, MENU press:back", replayLog());
+}
+
+static std::string gReleased;
+
+static void logRelease(uint8_t button) {
+  gReleased += keymapButtonName(button);
+  gReleased += " ";
+}
+
+void test_release_handler() {
+  Trace t;
+  traceFrame(t, appleFrame(KEY_SELECT));
+  traceRelease(t);
+  traceHold(t, appleFrame(KEY_UP), 10);
+  traceRelease(t);
+  gReleased.clear();
+  gestureSetReleaseHandler(logRelease);
+  replayRun(t);
+  gestureSetReleaseHandler(nullptr);
+  TEST_ASSERT_EQUAL_STRING("SELECT UP ", gReleased.c_str());
+}
+
+void test_cut_frame_then_press() {
+  Trace t;
+  traceFrame(t, appleFrame(KEY_UP), 12);
+  traceIdle(t, 30000);
+  traceFrame(t, appleFrame(KEY_DOWN));
+  replayRun(t);
+  TEST_ASSERT_EQUAL_UINT32(1, gReplayStats.rejects);
+  TEST_ASSERT_EQUAL(NEC_REJECT_TRUNCATED, gReplayStats.lastReject);
+  TEST_ASSERT_EQUAL_STRING("DOWN press:down", replayLog());
+}
+
+void test_live_settings() {
+  // a hold delay of 600 ms instead of 250: the hold starts on the repeat at 648 ms
+  TEST_ASSERT_TRUE(gestureIdle());
+  GestureTiming slow = kReplayTiming;
+  slow.holdMs = 600;
+  gestureSetTiming(slow);
+  Trace t;
+  traceHold(t, appleFrame(KEY_UP), 10);
+  replayRun(t);
+  gestureSetTiming(kReplayTiming);
+  std::string want = "UP press:up, " + repeated("UP repeat:up", 4);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), replayLog());
+
+  // a keymap that doesn't load leaves the active one alone
+  TEST_ASSERT_EQUAL_STRING("not found", keymapStage("/keymap.bin"));
+  TEST_ASSERT_FALSE(keymapCommit());
+  TEST_ASSERT_EQUAL_STRING("UP", keymapButtonName(keymapLookup(appleFrame(KEY_UP))));
+}
+
+// A hold of 10 repeats on the 108 ms grid; before the 5th is decoded the
+// loop stalls for stallUs without polling the timer wheel
+static std::string holdWithStall(uint32_t stallUs) {
+  replayClear();
+  uint8_t up = keymapLookup(appleFrame(KEY_UP));
+  unsigned long startUs = micros();
+  gestureFrame(up, startUs, 0);
+  for (uint32_t i = 1; i <= 10; i++) {
+    hostAdvanceUs(startUs + i * NEC_REPEAT_PERIOD_US - micros());
+    unsigned long frameStartUs = micros();
+    if (i == 5) gHostUs += stallUs;
+    gestureRepeat(frameStartUs);
+  }
+  hostAdvanceMs(1000);
+  return replayLog();
+}
+
+void test_stalled_loop_keeps_the_hold() {
+  std::string smooth  = holdWithStall(0);
+  std::string stalled = holdWithStall(100000);
+  std::string want    = "UP press:up, " + repeated("UP repeat:up", 8);
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), smooth.c_str());
+  TEST_ASSERT_EQUAL_STRING(want.c_str(), stalled.c_str());
+}
+
+// ===== Shipped keymap =====
+// tools/keymap.txt, for the chords the built-in map doesn't have
+static void useShippedKeymap() {
+  hostFsWrite("/shipped.bin", kKeymapBin, sizeof(kKeymapBin));
+  TEST_ASSERT_TRUE(keymapStage("/shipped.bin") == nullptr);
+  TEST_ASSERT_TRUE(keymapCommit());
+}
+
+static void useBuiltinKeymap() {
+  hostFsClear();
+  keymapBegin("/keymap.bin");
+}
+
+void test_chord_uses_up_the_lead() {
+  // PLAY then MENU inside PLAY's window: no playpause, no back
+  useShippedKeymap();
+  Trace t;
+  traceFrame(t, appleFrame(KEY_PLAY));
+  traceRelease(t, 100);
+  traceFrame(t, appleFrame(KEY_MENU));
+  traceRelease(t);
+  replayRun(t);
+  useBuiltinKeymap();
+  TEST_ASSERT_EQUAL_STRING("MENU chord:next target", replayLog());
+}
+
+void test_chord_lead_alone() {
+  // its tap comes once the window closes, as does one followed by another button
+  useShippedKeymap();
+  Trace t;
+  traceFrame(t, appleFrame(KEY_PLAY));
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_PLAY));
+  traceRelease(t, 100);
+  traceFrame(t, appleFrame(KEY_UP));
+  replayRun(t);
+  useBuiltinKeymap();
+  TEST_ASSERT_EQUAL_STRING("PLAY_PAUSE tap:playpause, PLAY_PAUSE tap:playpause, UP press:up", replayLog());
+}
+
+void test_chord_lead_held() {
+  // held into a hold, the lead can't start a chord any more
+  useShippedKeymap();
+  Trace t;
+  traceHold(t, appleFrame(KEY_PLAY), 4);
+  traceRelease(t, 100);
+  traceFrame(t, appleFrame(KEY_MENU));
+  traceRelease(t);
+  replayRun(t);
+  useBuiltinKeymap();
+  TEST_ASSERT_EQUAL_STRING("PLAY_PAUSE hold:shutdownmenu, MENU tap:back", replayLog());
+}
+
+void test_chord_in_profile() {
+  // music: MENU then SELECT is the context menu, MENU's tap doesn't go back first
+  useShippedKeymap();
+  keymapNextProfile();
+  Trace t;
+  traceFrame(t, appleFrame(KEY_MENU));
+  traceRelease(t, 100);
+  traceFrame(t, appleFrame(KEY_SELECT));
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_MENU));
+  traceRelease(t);
+  replayRun(t);
+  useBuiltinKeymap();
+  TEST_ASSERT_EQUAL_STRING("SELECT chord:contextmenu, MENU tap:back", replayLog());
+}
+
+int main() {
+  replayBegin();
+  UNITY_BEGIN();
+  RUN_TEST(test_press);
+  RUN_TEST(test_unknown_key);
+  RUN_TEST(test_tap_and_hold);
+  RUN_TEST(test_hold_repeats);
+  RUN_TEST(test_hold_acceleration);
+  RUN_TEST(test_double_needs_player);
+  RUN_TEST(test_single_after_multi_tap_window);
+  RUN_TEST(test_context);
+  RUN_TEST(test_jittery_hold);
+  RUN_TEST(test_lost_repeat_releases);
+  RUN_TEST(test_repeats_without_frame);
+  RUN_TEST(test_other_key_during_hold);
+  RUN_TEST(test_release_handler);
+  RUN_TEST(test_cut_frame_then_press);
+  RUN_TEST(test_live_settings);
+  RUN_TEST(test_stalled_loop_keeps_the_hold);
+  RUN_TEST(test_chord_uses_up_the_lead);
+  RUN_TEST(test_chord_lead_alone);
+  RUN_TEST(test_chord_lead_held);
+  RUN_TEST(test_chord_in_profile);
+  return UNITY_END();
+}
@@ -0,0 +1,88 @@
+// Keymap files: the shipped map as mkkeymap.py builds it, and broken ones
+
+#include <unity.h>
+
+#include <LittleFS.h>
+
+#include <vector>
+
+#include "keymap_bin.h"
+#include "kodi_state.h"
+#include "replay.h"
+
+// kodi_state.cpp isn't part of the host build
+static KodiState gCache = { -1, false, 0, false, false, false, 0, 0, false };
+KodiState*       gKodi = &gCache;
+
+static std::vector<uint8_t> shipped() {
+  return std::vector<uint8_t>(kKeymapBin, kKeymapBin + sizeof(kKeymapBin));
+}
+
+static const char* stage(const std::vector<uint8_t>& bin) {
+  hostFsWrite("/new.bin", bin.data(), bin.size());
+  return keymapStage("/new.bin");
+}
+
+void setUp() {
+  hostFsClear();
+}
+
+void tearDown() {}
+
+void test_loads_shipped_keymap() {
+  hostFsWrite("/keymap.bin", kKeymapBin, sizeof(kKeymapBin));
+  TEST_ASSERT_TRUE(keymapBegin("/keymap.bin"));
+  TEST_ASSERT_EQUAL(7, keymapButtons());
+  TEST_ASSERT_EQUAL_STRING("default", keymapProfileName());
+
+  uint8_t menu = keymapLookup(appleFrame(KEY_MENU));
+  uint8_t play = keymapLookup(appleFrame(KEY_PLAY));
+  TEST_ASSERT_EQUAL_STRING("MENU", keymapButtonName(menu));
+  TEST_ASSERT_EQUAL_STRING("PLAY_PAUSE", keymapButtonName(play));
+  TEST_ASSERT_EQUAL(KEY_NONE, keymapLookup(0x87EE | 0x42 << 16));
+  TEST_ASSERT_FALSE(keymapMatch(menu, KEY_PRESS));
+  TEST_ASSERT_TRUE(keymapChordLead(play));
+  const KeyRule* chord = keymapMatch(menu, KEY_CHORD, play);
+  TEST_ASSERT_TRUE(chord);
+  TEST_ASSERT_EQUAL(KEY_ACT_TARGET_NEXT, chord->action);
+
+  keymapNextProfile();
+  TEST_ASSERT_EQUAL_STRING("music", keymapProfileName());
+  TEST_ASSERT_TRUE(keymapChordLead(menu));   // MENU then SELECT
+  keymapNextProfile();
+}
+
+void test_truncated_file() {
+  std::vector<uint8_t> bin = shipped();
+  bin.pop_back();
+  TEST_ASSERT_EQUAL_STRING("size mismatch", stage(bin));
+  TEST_ASSERT_FALSE(keymapCommit());
+  bin.resize(sizeof(KeymapHeader) - 1);
+  TEST_ASSERT_EQUAL_STRING("bad header", stage(bin));
+  TEST_ASSERT_FALSE(keymapCommit());
+
+  // the complete file still goes in
+  TEST_ASSERT_TRUE(stage(shipped()) == nullptr);
+  TEST_ASSERT_TRUE(keymapCommit());
+}
+
+void test_bad_version() {
+  std::vector<uint8_t> bin = shipped();
+  bin[offsetof(KeymapHeader, version)] = KEYMAP_VERSION - 1;
+  TEST_ASSERT_EQUAL_STRING("unsupported version", stage(bin));
+  TEST_ASSERT_FALSE(keymapCommit());
+
+  // at boot it means the built-in map, where MENU is a plain press
+  hostFsWrite("/keymap.bin", bin.data(), bin.size());
+  TEST_ASSERT_FALSE(keymapBegin("/keymap.bin"));
+  TEST_ASSERT_TRUE(keymapMatch(keymapLookup(appleFrame(KEY_MENU)), KEY_PRESS));
+  TEST_ASSERT_FALSE(keymapChordLead(keymapLookup(appleFrame(KEY_PLAY))));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_loads_shipped_keymap);
+  RUN_TEST(test_truncated_file);
+  RUN_TEST(test_bad_version);
+  return UNITY_END();
+}
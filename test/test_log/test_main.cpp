@@ -0,0 +1,74 @@
+// Log ring: order, drain budget and dropped lines
+
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "kodi_state.h"
+#include "logger.h"
+
+// kodi_state.cpp isn't part of the host build
+static KodiState gCache = { -1, false, 0, false, false, false, 0, 0, false };
+KodiState*       gKodi = &gCache;
+
+static std::vector<std::string> gLines;
+
+static void sink(uint8_t level, const char* line) {
+  gLines.push_back(std::to_string(level) + " " + line);
+}
+
+void setUp() {
+  logFlush();
+  gLines.clear();
+  logSetSink(sink);
+}
+
+void tearDown() {}
+
+void test_lines_in_order() {
+  LOG_I("WiFi up");
+  LOG_D("UP HOLD start\n");
+  LOG_W("RPC timeout for %s", "Input.Up");
+  TEST_ASSERT_TRUE(logPending());
+  TEST_ASSERT_EQUAL(0, gLines.size());   // nothing leaves before the drain
+  logFlush();
+  TEST_ASSERT_FALSE(logPending());
+  TEST_ASSERT_EQUAL(3, gLines.size());
+  TEST_ASSERT_EQUAL_STRING("3 WiFi up", gLines[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("4 UP HOLD start", gLines[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("2 RPC timeout for Input.Up", gLines[2].c_str());
+}
+
+void test_poll_writes_what_the_fifo_takes() {
+  // 4 lines of 59 bytes and their newlines, 128 bytes of FIFO per poll
+  for (int i = 0; i < 4; i++) LOG_I("%059d", i);
+  logPoll();
+  TEST_ASSERT_EQUAL(3, gLines.size());   // the third is half written
+  TEST_ASSERT_TRUE(logPending());
+  logPoll();
+  TEST_ASSERT_EQUAL(4, gLines.size());
+  TEST_ASSERT_FALSE(logPending());
+}
+
+void test_full_ring_drops_and_says_so() {
+  std::string line(LOG_LINE_MAX - 1, 'x');
+  size_t fits = LOG_RING_BYTES / (line.size() + 2);
+  for (size_t i = 0; i < fits + 5; i++) LOG_D("%s", line.c_str());
+  logFlush();
+  TEST_ASSERT_EQUAL(fits, gLines.size());
+
+  LOG_I("after");
+  logFlush();
+  TEST_ASSERT_EQUAL(fits + 2, gLines.size());
+  TEST_ASSERT_EQUAL_STRING("2 (5 log lines dropped)", gLines[fits].c_str());
+  TEST_ASSERT_EQUAL_STRING("3 after", gLines[fits + 1].c_str());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_lines_in_order);
+  RUN_TEST(test_poll_writes_what_the_fifo_takes);
+  RUN_TEST(test_full_ring_drops_and_says_so);
+  return UNITY_END();
+}
@@ -0,0 +1,112 @@
+// Counters: what a replay bumps and the text page
+
+#include <unity.h>
+
+#include <string>
+
+#include "kodi_state.h"
+#include "replay.h"
+#include "web.h"
+
+// kodi_state.cpp isn't part of the host build
+static KodiState gCache = { -1, false, 0, false, false, false, 0, 0, false };
+KodiState*       gKodi = &gCache;
+
+struct StringPrint : public Print {
+  size_t write(uint8_t c) override {
+    s += (char)c;
+    return 1;
+  }
+  using Print::write;
+  std::string s;
+};
+
+static const char* name(uint8_t t) {
+  return t == 0 ? "tv" : "projector";
+}
+
+static std::string render() {
+  StringPrint out;
+  metricsPrint(out, 2, name);
+  return out.s;
+}
+
+static bool has(const std::string& s, const char* line) {
+  return s.find(std::string("\n") + line + "\n") != std::string::npos;
+}
+
+static uint8_t button(const char* want) {
+  for (uint8_t b = 0; b < keymapButtons(); b++) {
+    if (strcmp(keymapButtonName(b), want) == 0) return b;
+  }
+  return KEY_NONE;
+}
+
+void setUp() {
+  memset(&gMetrics, 0, sizeof(gMetrics));
+}
+
+void tearDown() {}
+
+void test_replay_counts() {
+  Trace t;
+  traceHold(t, appleFrame(KEY_UP), 3);
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_SELECT), 12);
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_SELECT));
+  replayRun(t);
+  // replayRun() ends with one more gap mark than the capture would push
+  TEST_ASSERT_EQUAL_UINT32(7, gMetrics.bursts);
+  TEST_ASSERT_EQUAL_UINT32(2, gMetrics.frames);
+  TEST_ASSERT_EQUAL_UINT32(3, gMetrics.repeats);
+  TEST_ASSERT_EQUAL_UINT32(1, gMetrics.rejects[NEC_REJECT_TRUNCATED]);
+  TEST_ASSERT_EQUAL_UINT32(1, gMetrics.presses[button("UP")]);
+  TEST_ASSERT_EQUAL_UINT32(1, gMetrics.presses[button("SELECT")]);
+}
+
+void test_text_page() {
+  gMetrics.frames = 7;
+  gMetrics.rejects[NEC_REJECT_BIT_SPACE] = 2;
+  gMetrics.presses[button("UP")] = 4;
+  gMetrics.calls[PL_ActUp] = 4;
+  gMetrics.rpc[0].http[2] = 4;
+  gMetrics.rpc[1].timeouts = 3;
+  gMetrics.rpc[1].errors   = 2;
+  gMetrics.rpc[1].queueMax = 5;
+  std::string s = render();
+  TEST_ASSERT_TRUE(has(s, "# TYPE ir_frames_total counter"));
+  TEST_ASSERT_TRUE(has(s, "ir_frames_total 7"));
+  TEST_ASSERT_TRUE(has(s, "ir_rejects_total{reason=\"bit space\"} 2"));
+  TEST_ASSERT_TRUE(has(s, "presses_total{button=\"UP\"} 4"));
+  TEST_ASSERT_TRUE(has(s, "rpc_calls_total{method=\"up\"} 4"));
+  TEST_ASSERT_TRUE(has(s, "rpc_http_responses_total{target=\"tv\",status=\"2xx\"} 4"));
+  TEST_ASSERT_TRUE(has(s, "rpc_errors_total{target=\"projector\"} 2"));
+  TEST_ASSERT_TRUE(has(s, "rpc_timeouts_total{target=\"tv\"} 0"));
+  TEST_ASSERT_TRUE(has(s, "rpc_timeouts_total{target=\"projector\"} 3"));
+  TEST_ASSERT_TRUE(has(s, "rpc_queue_depth_max{target=\"projector\"} 5"));
+  // methods and status classes that never happened stay out
+  TEST_ASSERT_EQUAL(std::string::npos, s.find("method=\"down\""));
+  TEST_ASSERT_EQUAL(std::string::npos, s.find("status=\"5xx\""));
+}
+
+void test_page_fits_web_buffer() {
+  for (uint8_t p = 0; p < PL_COUNT; p++) gMetrics.calls[p] = 4000000000UL;
+  for (uint8_t t = 0; t < RPC_TARGETS_MAX; t++) {
+    for (uint8_t c = 0; c < METRICS_HTTP_CLASSES; c++) gMetrics.rpc[t].http[c] = 4000000000UL;
+  }
+  std::string s = render();
+  char msg[48];
+  snprintf(msg, sizeof(msg), "%u bytes at worst", (unsigned)s.size());
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_LESS_THAN(WEB_OUT_MAX, s.size());
+}
+
+int main() {
+  replayBegin();
+  UNITY_BEGIN();
+  RUN_TEST(test_replay_counts);
+  RUN_TEST(test_text_page);
+  RUN_TEST(test_page_fits_web_buffer);
+  return UNITY_END();
+}
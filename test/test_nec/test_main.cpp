@@ -0,0 +1,217 @@
+// NEC decoder: frames, repeats and reject reasons on built traces
+
+#include <unity.h>
+
+#include "kodi_state.h"
+#include "replay.h"
+
+// kodi_state.cpp isn't part of the host build
+static KodiState gCache = { -1, false, 0, false, false, false, 0, 0, false };
+KodiState*       gKodi = &gCache;
+
+static const uint32_t kFrame = 0x5C87EE | 0x12UL << 24;
+
+struct Decoded {
+  uint32_t  frames;
+  uint32_t  repeats;
+  uint32_t  rejects;
+  uint32_t  value;
+  NecReject reject;
+};
+
+static void count(Decoded& out, const NecDecoder& d, NecEvent ev) {
+  if (ev == NEC_FRAME)  { out.frames++; out.value = d.value; }
+  if (ev == NEC_REPEAT) out.repeats++;
+  if (ev == NEC_REJECT) { out.rejects++; out.reject = d.reject; }
+}
+
+// Straight into the decoder, with a gap wherever the capture would mark one
+static Decoded decode(const Trace& t) {
+  NecDecoder d;
+  necInit(d, REPLAY_TOLERANCE_US);
+  Decoded out = {};
+  for (size_t i = 0; i < t.us.size(); i++) {
+    uint32_t us = t.us[i];
+    count(out, d, i == 0 || us > REPLAY_MAX_PULSE_US ? necGap(d) : necFeed(d, us));
+  }
+  count(out, d, necGap(d));
+  return out;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_clean_frame() {
+  Trace t;
+  traceFrame(t, kFrame);
+  Decoded out = decode(t);
+  TEST_ASSERT_EQUAL_UINT32(1, out.frames);
+  TEST_ASSERT_EQUAL_UINT32(0, out.rejects);
+  TEST_ASSERT_EQUAL_HEX32(kFrame, out.value);
+}
+
+void test_frame_before_stop_mark() {
+  Trace t;
+  traceFrame(t, kFrame);
+  NecDecoder d;
+  necInit(d, REPLAY_TOLERANCE_US);
+  necGap(d);
+  // header mark and space, 31 full bits, the 32nd bit's mark and space
+  size_t last = 1 + 2 + 64 - 1;
+  for (size_t i = 1; i < last; i++) TEST_ASSERT_EQUAL(NEC_NONE, necFeed(d, t.us[i]));
+  TEST_ASSERT_EQUAL(NEC_FRAME, necFeed(d, t.us[last]));
+  TEST_ASSERT_EQUAL(NEC_NONE, necFeed(d, t.us[last + 1]));
+}
+
+void test_repeats() {
+  Trace t;
+  traceHold(t, kFrame, 20);
+  Decoded out = decode(t);
+  TEST_ASSERT_EQUAL_UINT32(1, out.frames);
+  TEST_ASSERT_EQUAL_UINT32(20, out.repeats);
+  TEST_ASSERT_EQUAL_UINT32(0, out.rejects);
+}
+
+void test_jitter_within_tolerance() {
+  Trace t;
+  t.jitterUs   = 150;
+  t.markBiasUs = 60;
+  for (int i = 0; i < 50; i++) {
+    traceHold(t, kFrame, 3);
+    traceRelease(t);
+  }
+  Decoded out = decode(t);
+  TEST_ASSERT_EQUAL_UINT32(50, out.frames);
+  TEST_ASSERT_EQUAL_UINT32(150, out.repeats);
+  TEST_ASSERT_EQUAL_UINT32(0, out.rejects);
+  TEST_ASSERT_EQUAL_HEX32(kFrame, out.value);
+}
+
+void test_stretched_header_rejected() {
+  Trace t;
+  t.markBiasUs = REPLAY_TOLERANCE_US + 20;
+  traceFrame(t, kFrame);
+  Decoded out = decode(t);
+  TEST_ASSERT_EQUAL_UINT32(0, out.frames);
+  TEST_ASSERT_EQUAL_UINT32(1, out.rejects);
+  TEST_ASSERT_EQUAL(NEC_REJECT_HDR_MARK, out.reject);
+}
+
+void test_bad_header_space() {
+  Trace t;
+  traceFrame(t, kFrame);
+  t.us[2] = 3400;
+  Decoded out = decode(t);
+  TEST_ASSERT_EQUAL_UINT32(0, out.frames);
+  TEST_ASSERT_EQUAL(NEC_REJECT_HDR_SPACE, out.reject);
+}
+
+void test_bad_bit_space() {
+  Trace t;
+  traceFrame(t, kFrame);
+  t.us[10] = 1100;
+  Decoded out = decode(t);
+  TEST_ASSERT_EQUAL_UINT32(0, out.frames);
+  TEST_ASSERT_EQUAL(NEC_REJECT_BIT_SPACE, out.reject);
+}
+
+void test_truncated_then_next_frame() {
+  Trace t;
+  traceFrame(t, kFrame, 12);
+  traceIdle(t, 40000);
+  traceFrame(t, kFrame);
+  Decoded out = decode(t);
+  TEST_ASSERT_EQUAL_UINT32(1, out.frames);
+  TEST_ASSERT_EQUAL_UINT32(1, out.rejects);
+  TEST_ASSERT_EQUAL(NEC_REJECT_TRUNCATED, out.reject);
+}
+
+void test_overlapping_frame_skipped_until_gap() {
+  // a second burst starts before the line was idle long enough for a gap:
+  // its header lands in the middle of the first frame and both are lost
+  Trace t;
+  traceFrame(t, kFrame, 12);
+  traceIdle(t, 6000);
+  traceFrame(t, kFrame);
+  traceRelease(t);
+  traceFrame(t, kFrame);
+  Decoded out = decode(t);
+  TEST_ASSERT_EQUAL_UINT32(1, out.frames);
+  TEST_ASSERT_EQUAL_UINT32(1, out.rejects);
+  TEST_ASSERT_EQUAL(NEC_REJECT_BIT_SPACE, out.reject);
+}
+
+void test_ring_keeps_each_frame_start() {
+  // two frames queued while loop() was busy, and a mark that doesn't fit
+  IrRing<8> ring;
+  TEST_ASSERT_TRUE(ring.pushMark(0x12345678));
+  TEST_ASSERT_TRUE(ring.push(9000));
+  TEST_ASSERT_TRUE(ring.pushMark(0x9ABCDEF0));
+  TEST_ASSERT_FALSE(ring.pushMark(1));
+  TEST_ASSERT_TRUE(ring.overflow);
+  TEST_ASSERT_EQUAL(7, ring.size());
+
+  uint16_t v;
+  TEST_ASSERT_TRUE(ring.pop(v) && v == IR_FRAME_MARK);
+  TEST_ASSERT_EQUAL_HEX32(0x12345678, ring.popStamp());
+  TEST_ASSERT_TRUE(ring.pop(v) && v == 9000);
+  TEST_ASSERT_TRUE(ring.pop(v) && v == IR_FRAME_MARK);
+  TEST_ASSERT_EQUAL_HEX32(0x9ABCDEF0, ring.popStamp());
+  TEST_ASSERT_FALSE(ring.pop(v));
+}
+
+void test_late_header_after_wake() {
+  // woken from light sleep, the first edge is stamped 3 ms into the mark
+  Trace t;
+  traceFrame(t, kFrame);
+  t.us[1] -= 3000;
+  TEST_ASSERT_EQUAL(NEC_REJECT_HDR_MARK, decode(t).reject);
+
+  NecDecoder d;
+  necInit(d, REPLAY_TOLERANCE_US);
+  Decoded out = {};
+  necGap(d);
+  necLateStart(d, 5000);
+  for (size_t i = 1; i < t.us.size(); i++) count(out, d, necFeed(d, t.us[i]));
+  TEST_ASSERT_EQUAL_UINT32(1, out.frames);
+  TEST_ASSERT_EQUAL_HEX32(kFrame, out.value);
+  TEST_ASSERT_EQUAL_UINT32(32, d.jitter.marks);   // the short header isn't jitter
+
+  // only the burst right after the wake
+  count(out, d, necGap(d));
+  for (size_t i = 1; i < t.us.size(); i++) count(out, d, necFeed(d, t.us[i]));
+  TEST_ASSERT_EQUAL_UINT32(1, out.rejects);
+  TEST_ASSERT_EQUAL(NEC_REJECT_HDR_MARK, out.reject);
+}
+
+void test_jitter_stats() {
+  Trace t;
+  t.markBiasUs = 80;
+  traceFrame(t, kFrame);
+  NecDecoder d;
+  necInit(d, REPLAY_TOLERANCE_US);
+  necGap(d);
+  for (size_t i = 1; i < t.us.size(); i++) necFeed(d, t.us[i]);
+  TEST_ASSERT_EQUAL_UINT32(33, d.jitter.marks);
+  TEST_ASSERT_EQUAL_UINT32(33, d.jitter.spaces);
+  TEST_ASSERT_EQUAL_INT32(33 * 80, d.jitter.markDevSumUs);
+  TEST_ASSERT_EQUAL_INT32(-33 * 80, d.jitter.spaceDevSumUs);
+  TEST_ASSERT_EQUAL_UINT16(80, d.jitter.maxDevUs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_frame);
+  RUN_TEST(test_frame_before_stop_mark);
+  RUN_TEST(test_repeats);
+  RUN_TEST(test_jitter_within_tolerance);
+  RUN_TEST(test_stretched_header_rejected);
+  RUN_TEST(test_bad_header_space);
+  RUN_TEST(test_bad_bit_space);
+  RUN_TEST(test_truncated_then_next_frame);
+  RUN_TEST(test_overlapping_frame_skipped_until_gap);
+  RUN_TEST(test_ring_keeps_each_frame_start);
+  RUN_TEST(test_late_header_after_wake);
+  RUN_TEST(test_jitter_stats);
+  return UNITY_END();
+}
@@ -0,0 +1,74 @@
+// Timer wheel: deadlines and where millis() wraps
+
+#include <unity.h>
+
+#include "host.h"
+#include "kodi_state.h"
+#include "timer_wheel.h"
+
+// kodi_state.cpp isn't part of the host build
+static KodiState gCache = { -1, false, 0, false, false, false, 0, 0, false };
+KodiState*       gKodi = &gCache;
+
+static uint32_t gFired;
+static uint32_t gFiredAtMs;
+
+static void fire(uint32_t arg) {
+  gFired += arg;
+  gFiredAtMs = millis();
+}
+
+void setUp() {
+  gFired     = 0;
+  gFiredAtMs = 0;
+}
+
+void tearDown() {}
+
+void test_fires_once_when_due() {
+  Timer t;
+  timerInit(t, fire, 1);
+  timerArm(t, 100);
+  uint32_t armedMs = millis();
+  hostAdvanceMs(99);
+  TEST_ASSERT_EQUAL(0, gFired);
+  TEST_ASSERT_TRUE(timerArmed(t));
+  hostAdvanceMs(10);
+  TEST_ASSERT_EQUAL(1, gFired);
+  TEST_ASSERT_TRUE(gFiredAtMs - armedMs >= 100 && gFiredAtMs - armedMs < 100 + TIMER_TICK_MS);
+  hostAdvanceMs(1000);
+  TEST_ASSERT_EQUAL(1, gFired);
+}
+
+void test_millis_wrap() {
+  // the wheel starts 200 ms before millis() wraps, a timer is due 100 ms after it
+  gHostUs = ((uint64_t)1 << 32) * 1000 - 200000;
+  timerPoll();
+  Timer t;
+  timerInit(t, fire, 1);
+  timerArm(t, 300);
+  TEST_ASSERT_EQUAL(300, timerRemainingMs(t));
+  TEST_ASSERT_EQUAL(300, timerNextMs(1000));
+
+  hostAdvanceMs(250);   // past the wrap
+  TEST_ASSERT_TRUE(millis() < 100);
+  TEST_ASSERT_EQUAL(0, gFired);
+  TEST_ASSERT_EQUAL(50, timerRemainingMs(t));
+  TEST_ASSERT_EQUAL(50, timerNextMs(1000));
+
+  hostAdvanceMs(50);
+  TEST_ASSERT_EQUAL(1, gFired);
+  TEST_ASSERT_EQUAL(100, gFiredAtMs);
+
+  // and the wheel keeps time after it
+  timerArm(t, 20);
+  hostAdvanceMs(20);
+  TEST_ASSERT_EQUAL(2, gFired);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_millis_wrap);   // first, before anything starts the wheel
+  RUN_TEST(test_fires_once_when_due);
+  return UNITY_END();
+}
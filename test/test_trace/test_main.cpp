@@ -0,0 +1,153 @@
+// IR trace: what is kept, the dump format and replaying a dump
+
+#include <unity.h>
+
+#include <string>
+
+#include "kodi_state.h"
+#include "replay.h"
+
+// kodi_state.cpp isn't part of the host build
+static KodiState gCache = { -1, false, 0, false, false, false, 0, 0, false };
+KodiState*       gKodi = &gCache;
+
+struct StringPrint : public Print {
+  size_t write(uint8_t c) override {
+    s += (char)c;
+    return 1;
+  }
+  using Print::write;
+  std::string s;
+};
+
+static std::string dump(uint8_t from = 0, uint8_t count = IR_TRACE_RECORDS) {
+  StringPrint out;
+  irTracePrint(out, from, count);
+  return out.s;
+}
+
+static uint32_t lines(const std::string& s) {
+  uint32_t n = 0;
+  for (size_t i = 0; i < s.size(); i++) n += s[i] == '\n' && i + 1 < s.size() && s[i + 1] != '#';
+  return n;
+}
+
+static bool has(const std::string& s, const char* what) {
+  return s.find(what) != std::string::npos;
+}
+
+void setUp() {
+  irTraceClear();
+}
+
+void tearDown() {
+  irTraceSetMode(IR_TRACE_OFF);
+}
+
+void test_off_keeps_nothing() {
+  Trace t;
+  traceFrame(t, appleFrame(KEY_UP), 10);
+  replayRun(t);
+  TEST_ASSERT_EQUAL_UINT8(0, irTraceCount());
+}
+
+void test_rejects_only() {
+  irTraceSetMode(IR_TRACE_REJECTS);
+  Trace t;
+  traceFrame(t, appleFrame(KEY_UP));
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_DOWN));
+  t.us[t.us.size() - 66] = 3400;   // its header space
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_LEFT), 12);
+  traceRelease(t);
+  traceRepeat(t);
+  replayRun(t);
+
+  std::string s = dump();
+  TEST_ASSERT_EQUAL_UINT8(2, irTraceCount());
+  TEST_ASSERT_TRUE(has(s, "# reject: header space"));
+  TEST_ASSERT_TRUE(has(s, "# reject: truncated"));
+  TEST_ASSERT_TRUE(!has(s, "# frame"));
+}
+
+void test_all_keeps_the_last() {
+  irTraceSetMode(IR_TRACE_ALL);
+  Trace t;
+  for (uint8_t i = 0; i < IR_TRACE_RECORDS + 4; i++) {
+    traceFrame(t, appleFrame(i));
+    traceRelease(t);
+  }
+  replayRun(t);
+
+  std::string s = dump();
+  TEST_ASSERT_EQUAL_UINT8(IR_TRACE_RECORDS, irTraceCount());
+  TEST_ASSERT_EQUAL_UINT32(IR_TRACE_RECORDS, lines(s));
+  TEST_ASSERT_TRUE(!has(s, "# frame 000387EE"));
+  TEST_ASSERT_TRUE(has(s, "# frame 000487EE"));
+  TEST_ASSERT_TRUE(has(s, "# frame 000B87EE"));
+}
+
+void test_paging() {
+  irTraceSetMode(IR_TRACE_ALL);
+  Trace t;
+  for (uint8_t i = 0; i < 6; i++) traceRepeat(t);
+  replayRun(t);
+  TEST_ASSERT_EQUAL_UINT32(4, lines(dump(0, 4)));
+  TEST_ASSERT_EQUAL_UINT32(2, lines(dump(4, 4)));
+}
+
+void test_record_format() {
+  irTraceSetMode(IR_TRACE_ALL);
+  Trace t;
+  traceFrame(t, appleFrame(KEY_SELECT));
+  // edges after the stop mark that never make a gap
+  for (uint8_t i = 0; i < 4; i++) { traceSpace(t, 600); traceMark(t, 600); }
+  replayRun(t);
+
+  std::string s = dump();
+  TEST_ASSERT_TRUE(has(s, " 68 9000 4500 560 "));
+  TEST_ASSERT_TRUE(has(s, "# frame 005C87EE, lag 0 us, cut\n"));
+}
+
+void test_replay_dump() {
+  // what a recorded dump replays to is what the live burst did
+  irTraceSetMode(IR_TRACE_ALL);
+  gKodi->playerId = 1;
+  Trace t;
+  t.jitterUs   = 120;
+  t.markBiasUs = 50;
+  traceHold(t, appleFrame(KEY_UP), 4);
+  traceRelease(t);
+  traceFrame(t, appleFrame(KEY_LEFT));
+  traceRelease(t, 150);
+  traceFrame(t, appleFrame(KEY_LEFT));
+  replayRun(t);
+  std::string live = replayLog();
+  ReplayStats stats = gReplayStats;
+  TEST_ASSERT_EQUAL_UINT8(7, irTraceCount());
+
+  std::string s = dump();
+  irTraceSetMode(IR_TRACE_OFF);
+  Trace parsed;
+  TEST_ASSERT_EQUAL_UINT32(7, traceParse(parsed, s.c_str()));
+  replayRun(parsed);
+  gKodi->playerId = -1;
+
+  TEST_ASSERT_EQUAL_STRING("UP press:up, UP repeat:up, UP repeat:up, LEFT double:stepback", live.c_str());
+  TEST_ASSERT_EQUAL_STRING(live.c_str(), replayLog());
+  TEST_ASSERT_EQUAL_UINT32(stats.frames, gReplayStats.frames);
+  TEST_ASSERT_EQUAL_UINT32(stats.repeats, gReplayStats.repeats);
+}
+
+int main() {
+  replayBegin();
+  UNITY_BEGIN();
+  RUN_TEST(test_off_keeps_nothing);
+  RUN_TEST(test_rejects_only);
+  RUN_TEST(test_all_keeps_the_last);
+  RUN_TEST(test_paging);
+  RUN_TEST(test_record_format);
+  RUN_TEST(test_replay_dump);
+  return UNITY_END();
+}
@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""Compile a text keymap into the binary /keymap.bin read by src/keymap.cpp.
+
+    python3 tools/mkkeymap.py tools/keymap.txt data/keymap.bin
+    pio run -t uploadfs
+
+With --header the same bytes are written as a C array instead, which is
+how the native tests get the shipped map (test/host/keymap_bin.h):
+
+    python3 tools/mkkeymap.py --header tools/keymap.txt test/host/keymap_bin.h
+
+Text format, one statement per line, '#' starts a comment:
+
+    profile <name>                     profiles, the first is active at boot
+    remote  <name> <addr> [<mask>]     NEC address (frame bits 0-15)
+    button  <remote> <name> <key> [hold=<ms>] [multi=<ms>]
+      <trigger> [<context>] <action> [@<profile>,...]
+      chord <first button> [<context>] <action> [@<profile>,...]
+
+Buttons are matched on the key byte (frame bits 16-23). hold= and multi=
+override the firmware's hold delay and multi-tap/chord window.
+Rules belong to the button above them and are tried in order.
+  trigger: press double triple hold repeat tap
+  context: always player fullscreen not-fullscreen pure-fullscreen
+  action:  a payload label from src/payloads.h, next-profile or next-target
+"""
+
+import re
+import struct
+import sys
+from pathlib import Path
+
+VERSION = 2
+NAME_LEN = 12
+LIMITS = {"profiles": 8, "remotes": 4, "buttons": 32, "rules": 96}
+
+TRIGGERS = ["press", "double", "hold", "repeat", "tap", "triple", "chord"]
+CONTEXTS = ["always", "player", "fullscreen", "not-fullscreen", "pure-fullscreen"]
+ACT_PROFILE_NEXT = 0xFE
+ACT_TARGET_NEXT = 0xFD
+NONE = 0xFF
+
+
+def payload_labels():
+    src = (Path(__file__).resolve().parent.parent / "src" / "payloads.h").read_text()
+    table = src[src.index("#define KODI_PAYLOADS(X)"):]
+    table = table[:table.index("#define KODI_PAYLOAD_DECL")]
+    return re.findall(r'X\(\s*\w+\s*,\s*"([^"]+)"', table)
+
+
+def name_field(name, what):
+    raw = name.encode()
+    if len(raw) >= NAME_LEN:
+        raise ValueError(f"{what} name '{name}' longer than {NAME_LEN - 1} chars")
+    return raw.ljust(NAME_LEN, b"\0")
+
+
+def compile_keymap(text):
+    labels = payload_labels()
+    profiles, remotes, buttons, rules = [], [], [], []
+
+    for lineno, line in enumerate(text.splitlines(), 1):
+        words = line.split("#", 1)[0].split()
+        if not words:
+            continue
+        try:
+            kw = words[0]
+            if kw == "profile":
+                profiles.append(words[1])
+            elif kw == "remote":
+                mask = int(words[3], 0) if len(words) > 3 else 0xFFFF
+                remotes.append((words[1], int(words[2], 0), mask))
+            elif kw == "button":
+                remote = [r[0] for r in remotes].index(words[1])
+                key = int(words[3], 0)
+                if any(b[0] == remote and b[2] == key for b in buttons):
+                    raise ValueError("duplicate button")
+                opts = dict(w.split("=", 1) for w in words[4:])
+                hold = int(opts.pop("hold", 0))
+                multi = int(opts.pop("multi", 0))
+                if opts:
+                    raise ValueError(f"unknown option {next(iter(opts))}")
+                buttons.append((remote, words[2], key, hold, multi))
+            elif kw in TRIGGERS:
+                if not buttons:
+                    raise ValueError("rule before any button")
+                mask = 0xFF
+                if words[-1].startswith("@"):
+                    mask = 0
+                    for p in words.pop()[1:].split(","):
+                        mask |= 1 << profiles.index(p)
+                lead = words.pop(1) if kw == "chord" else None
+                context = words[1] if len(words) == 3 else "always"
+                action = words[-1]
+                specials = {"next-profile": ACT_PROFILE_NEXT, "next-target": ACT_TARGET_NEXT}
+                act = specials[action] if action in specials else labels.index(action)
+                rules.append([len(buttons) - 1, mask, TRIGGERS.index(kw), CONTEXTS.index(context), act, lead, lineno])
+            else:
+                raise ValueError(f"unknown statement '{kw}'")
+        except (IndexError, ValueError) as e:
+            sys.exit(f"line {lineno}: {e or 'bad syntax'}: {line.strip()}")
+
+    for rule in rules:
+        lead = rule.pop(5)
+        lineno = rule.pop()
+        if lead is None:
+            rule.append(NONE)
+            continue
+        # prefer the lead on the same remote
+        own = buttons[rule[0]][0]
+        found = sorted((b[0] != own, i) for i, b in enumerate(buttons) if b[1] == lead)
+        if not found or found[0][1] == rule[0]:
+            sys.exit(f"line {lineno}: bad chord lead '{lead}'")
+        rule.append(found[0][1])
+
+    counts = {"profiles": profiles, "remotes": remotes, "buttons": buttons, "rules": rules}
+    for what, items in counts.items():
+        if not 0 < len(items) <= LIMITS[what]:
+            sys.exit(f"need 1..{LIMITS[what]} {what}, got {len(items)}")
+
+    out = bytearray(b"KMAP")
+    out += struct.pack("<BBBBB3x", VERSION, len(profiles), len(remotes), len(buttons), len(rules))
+    for p in profiles:
+        out += name_field(p, "profile")
+    for name, addr, mask in remotes:
+        out += struct.pack("<HH", addr, mask) + name_field(name, "remote")
+    for remote, name, key, hold, multi in buttons:
+        out += struct.pack("<BBHH", remote, key, hold, multi) + name_field(name, "button")
+    for rule in rules:
+        out += struct.pack("<BBBBBB", *rule)
+    return bytes(out)
+
+
+def c_header(data, src):
+    lines = [f"// Generated from {src} by tools/mkkeymap.py --header, do not edit",
+             "", "#pragma once", "", "#include <stdint.h>", "",
+             "const uint8_t kKeymapBin[] = {"]
+    for i in range(0, len(data), 12):
+        lines.append("  " + ", ".join(f"0x{b:02X}" for b in data[i:i + 12]) + ",")
+    lines.append("};")
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    args = sys.argv[1:]
+    header = args[:1] == ["--header"]
+    if header:
+        args = args[1:]
+    if len(args) != 2:
+        sys.exit(f"usage: {sys.argv[0]} [--header] keymap.txt keymap.bin")
+    data = compile_keymap(Path(args[0]).read_text())
+    out = Path(args[1])
+    out.parent.mkdir(parents=True, exist_ok=True)
+    if header:
+        out.write_text(c_header(data, args[0]))
+    else:
+        out.write_bytes(data)
+    print(f"{args[1]}: {len(data)} bytes")
+
+
+if __name__ == "__main__":
+    main()